@@ -5,10 +5,14 @@
 #include <chrono>
 #include <vector>
 #include <atomic>
-#include <iostream>
+#include <functional>
+#include <string_view>
 
 #include <nlohmann/json.hpp>
 
+#include "logger.hpp"
+#include "sse_parser.hpp"
+
 namespace openai {
 		using Json = nlohmann::json;
 
@@ -67,8 +71,26 @@ namespace openai {
 			}
 		}
 
+		/// @brief Inverse of messageTypeToString
+		static MessageType messageTypeFromString(const std::string& name) {
+			static const MessageType types[] = {
+				MessageType::CachedSelect, MessageType::CachedBegin, MessageType::CachedWarn, MessageType::CachedFatal,
+				MessageType::CachedSuccess, MessageType::Cached, MessageType::AIGeneratedResponse, MessageType::None,
+				MessageType::UserTranscription, MessageType::studentRelinquishingControl, MessageType::studentAssertingControl,
+			};
+			for (MessageType type : types) {
+				if (messageTypeToString(type) == name) {
+					return type;
+				}
+			}
+			return MessageType::None;
+		}
+
 		class Message {
 		public:
+			/// @brief Callback receiving each streamed content delta; `finished` is set once the response is complete
+			using DeltaCallback = std::function<void(std::string_view delta, bool finished)>;
+
 			// Constructors
 			Message(MessageType type) : m_type(type), m_lastUpdated(std::chrono::system_clock::now()) {}
 			
@@ -92,60 +114,37 @@ namespace openai {
 				return !m_finalTranscript.empty();
 			}
 
+			/// @brief Set the text and word timings of a cached message, starting its word clock now
+			void setWords(const std::string& text, std::vector<Word> words) {
+				m_text = text;
+				m_words = std::move(words);
+				m_wordsStartTime = std::chrono::steady_clock::now();
+				m_lastProcessedWordIndex = 0;
+				m_lastUpdated = std::chrono::system_clock::now();
+			}
+
+			/// @brief Register a callback invoked (on the network thread) for every streamed AI response delta
+			void setDeltaCallback(DeltaCallback callback) {
+				m_onDelta = std::move(callback);
+			}
+
 			
 			/// @brief Set the response from the API
 			void setAIResponse(const std::string& data) {
-				if (!isAI(this->m_type)) {
+				setAIResponse(data.data(), data.size());
+			}
+
+			/// @brief Feed raw server-sent event bytes of a streaming completion, as received
+			void setAIResponse(const char* data, size_t size) {
+				if (!isAI(this->m_type) || !m_isUpdating) {
 					return;
 				}
-
-				// Append new data to the buffer
-				m_buffer += data;
-
-				// Try to find a complete JSON object
-				size_t startPos = m_buffer.find("data: ");
-				while (startPos != std::string::npos) {
-					size_t endPos = m_buffer.find("\n\n", startPos); // Assuming "\n\n" is the delimiter between events
-					if (endPos == std::string::npos) {
-						// If we don't have the complete JSON object, break and wait for more data
-						break;
-					}
-
-					// Extract the JSON object
-					std::string json_data = m_buffer.substr(startPos + 6, endPos - (startPos + 6)); // Remove "data: " prefix
-					m_buffer.erase(0, endPos + 2); // Remove the processed object from the buffer
-
-					// Parse the JSON data
-					Json parsed;
-					try {
-						parsed = Json::parse(json_data);
-					}
-					catch (std::exception&) {
-						// If parsing fails, it's not a valid JSON, so we continue to the next object
-						startPos = m_buffer.find("data: ", endPos);
-						continue;
-					}
-
-					// Process the parsed JSON as before
-					for (const auto& choice : parsed["choices"]) {
-						if (choice.contains("delta") && choice["delta"].contains("content")) {
-							std::string chunk = choice["delta"]["content"].get<std::string>();
-							std::cout << chunk;
-							m_text += chunk;
-						}
-						if (choice.contains("finish_reason") && !choice["finish_reason"].is_null()) {
-							std::cout << std::endl;
-							m_isUpdating = false;
-						}
-					}
-					if (!m_isUpdating) {
-						std::cout << "Finished updating: " << messageTypeToString(m_type) << '\n';
-						break;
-					}
-
-					// Look for the next JSON object
-					startPos = m_buffer.find("data: ");
+				if (!m_parserReady) {
+					m_parser.setTokenCallback([this](std::string_view token) { onToken(token); });
+					m_parser.setFinishCallback([this](std::string_view) { onFinish(); });
+					m_parserReady = true;
 				}
+				m_parser.feed(data, size);
 			}
 
 
@@ -154,8 +153,28 @@ namespace openai {
 			std::string getText() const { return m_text; }
 			std::chrono::system_clock::time_point getLastUpdated() const { return m_lastUpdated; }
 			bool isUpdating() const { return m_isUpdating; }
+			const std::vector<Word>& getWords() const { return m_words; }
+			std::chrono::steady_clock::time_point getWordsStartTime() const { return m_wordsStartTime; }
 
 		private:
+			void onToken(std::string_view token) {
+				m_text.append(token.data(), token.size());
+				if (m_onDelta) {
+					m_onDelta(token, false);
+				}
+			}
+
+			void onFinish() {
+				if (!m_isUpdating) {
+					return;
+				}
+				m_isUpdating = false;
+				if (m_onDelta) {
+					m_onDelta({}, true);
+				}
+				OPENAI_LOG_DEBUG("message_finished", "%s: %zu bytes", messageTypeToString(m_type).c_str(), m_text.size());
+			}
+
 			// General fields
 			MessageType m_type{ MessageType::None }; ///< Type of message
 			std::string m_text{ "" }; ///< Text of the message
@@ -169,10 +188,12 @@ namespace openai {
 			// Fields specific to cached messages
 			std::vector<Word> m_words; ///< Vector of words in the cached message
 			std::chrono::steady_clock::time_point m_wordsStartTime; ///< Start time of the words
-			size_t m_lastProcessedWordIndex; ///< Index of the last processed word
+			size_t m_lastProcessedWordIndex{ 0 }; ///< Index of the last processed word
 
 			// Fields specific to AI generated response
-			std::string m_buffer{ "" }; ///< Buffer to hold incomplete JSON data
+			SseParser m_parser; ///< Incremental parser of the streamed events
+			bool m_parserReady{ false }; ///< Whether m_parser's callbacks point at this message
+			DeltaCallback m_onDelta; ///< Optional consumer of streamed deltas (e.g. a SpeechPipeline)
 
 		};
 
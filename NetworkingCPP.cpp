@@ -45,7 +45,106 @@ bool getResponse(openai::Message& msg) {
 }
 
 
-int main() {
+// Offline step: render every cached phrase of a manifest into a memory-mappable PCM bank
+int buildPhraseBank(const char* manifestPath, const char* bankPath) {
+    try {
+        openai::OpenAI openAI{ };
+        openai::PhraseBankBuilder builder;
+        builder.renderFromManifest(openAI, manifestPath);
+        builder.write(bankPath);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to build phrase bank: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote phrase bank: " << bankPath << std::endl;
+    return 0;
+}
+
+
+// Stream audio to the realtime transcription API for `seconds`, from the microphone or a synthetic signal,
+// uploading only the detected speech when `gated`
+int transcribe(double seconds, bool synthetic, bool gated) {
+    // Fetches the first token in the background while the source is prepared, then keeps it fresh
+    const char* apiKey = std::getenv("ASSEMBLYAI_API_KEY");
+    assemblyai::TokenManager tokens{ apiKey ? apiKey : "" };
+
+    openai::Message transcript{ openai::MessageType::UserTranscription };
+    assemblyai::RealtimeTranscriber::Options options;
+    options.wordBoost = { "i have control", "you have control" };
+    assemblyai::RealtimeTranscriber transcriber{ transcript, options };
+
+    std::unique_ptr<openai::AudioSource> source;
+    if (synthetic) {
+        // Bursts of a gliding tone over faint noise stand in for short calls between silence; the
+        // stand-in transcribes them regardless of content
+        std::vector<float> signal(static_cast<size_t>(seconds * options.sampleRate));
+        const size_t period = static_cast<size_t>(4 * options.sampleRate);
+        const size_t burst = static_cast<size_t>(1.2 * options.sampleRate);
+        double phase = 0.0;
+        uint32_t noise = 1;
+        for (size_t i = 0; i < signal.size(); ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            signal[i] = 0.002f * (static_cast<float>(noise >> 8) / (1u << 24) - 0.5f);
+            if (i % period < burst) {
+                phase += 2 * 3.14159265358979323846 * (200.0 + 100.0 * std::sin(i * 2e-4)) / options.sampleRate;
+                signal[i] += 0.3f * static_cast<float>(std::sin(phase));
+            }
+        }
+        source = std::make_unique<openai::SyntheticSource>(std::move(signal));
+    }
+    else {
+        source = std::make_unique<openai::PortAudioSource>();
+    }
+
+    if (gated) {
+        // Only speech is uploaded; the end of each utterance is where a chat request could start
+        openai::SpeechCapture capture{ transcriber };
+        capture.onUtteranceEnd([](const openai::Utterance& utterance) {
+            OPENAI_LOG_INFO("utterance_end", "Utterance %zu ended after %zu samples", utterance.index, utterance.endSample - utterance.startSample);
+        });
+        if (!transcriber.connect(tokens) || !capture.start(*source)) {
+            std::cout << "Could not start realtime transcription" << std::endl;
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        capture.stop();
+        transcriber.stop();
+        std::cout << "Speech capture: " << capture.toJson().dump(2) << std::endl;
+    }
+    else {
+        if (!transcriber.start(tokens, *source)) {
+            std::cout << "Could not start realtime transcription" << std::endl;
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        transcriber.stop();
+    }
+    std::cout << "Transcript: " << transcript.getText() << std::endl;
+    std::cout << "Realtime: " << transcriber.toJson().dump(2) << std::endl;
+    std::cout << "Capture: " << source->statsJson().dump(2) << std::endl;
+    std::cout << "Tokens: " << tokens.toJson().dump(2) << std::endl;
+    return 0;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::string{ argv[1] } == "--build-phrase-bank") {
+        return buildPhraseBank(argv[2], argv[3]);
+    }
+    if (argc == 2 && std::string{ argv[1] } == "--bench-logging") {
+        return openai::logging_benchmark_main();
+    }
+    if (argc == 2 && std::string{ argv[1] } == "--bench-ring") {
+        return openai::ring_benchmark_main();
+    }
+    if ((argc == 2 || argc == 3) && std::string{ argv[1] } == "--bench-sse") {
+        return openai::sse_benchmark_main(argc == 3 ? argv[2] : "");
+    }
+    if (argc == 2 && std::string{ argv[1] } == "--check-opus-frames") {
+        return openai::opus_frame_check_main();
+    }
+
     char buffer[MAX_PATH];
     GetCurrentDirectory(MAX_PATH, buffer);
     std::cout << "Current Working Directory: " << buffer << std::endl;
@@ -70,15 +169,114 @@ int main() {
 		return 1;
 	}
 
+    // "--sink=null" paces playback against a simulated device clock, "--sink=wav:<path>" renders to a file,
+    // "--mock" answers every request from a local MockServer instead of the real APIs,
+    // "--format=<opus|mp3|flac|wav|pcm>" picks the response_format to request and decode,
+    // "--barge-in-after=<ms>" interrupts the speech that long after the request, as a user talking over it would,
+    // "--log-file=<path>" appends the JSON-lines log there instead of stderr,
+    // "--transcribe=<seconds>" streams the microphone (a synthetic signal with --mock) to realtime transcription instead,
+    // "--vad" makes it upload only the speech detected in the captured audio
+    std::unique_ptr<openai::AudioSink> sink = std::make_unique<openai::PortAudioSink>();
+    std::unique_ptr<openai::MockServer> mockServer;
+    openai::AudioFormat format = openai::AudioFormat::Opus;
+    long long bargeInAfterMs = -1;
+    double transcribeSeconds = 0.0;
+    bool gateSpeech = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sink=null") {
+            sink = std::make_unique<openai::NullSink>();
+        }
+        else if (arg.rfind("--sink=wav:", 0) == 0) {
+            sink = std::make_unique<openai::WavFileSink>(arg.substr(11));
+        }
+        else if (arg.rfind("--format=", 0) == 0) {
+            if (!openai::parseAudioFormat(arg.substr(9), format) || !openai::canDecode(format)) {
+                std::cout << "Unsupported response format: " << arg.substr(9) << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--barge-in-after=", 0) == 0) {
+            bargeInAfterMs = std::stoll(arg.substr(17));
+        }
+        else if (arg.rfind("--transcribe=", 0) == 0) {
+            transcribeSeconds = std::stod(arg.substr(13));
+        }
+        else if (arg == "--vad") {
+            gateSpeech = true;
+        }
+        else if (arg.rfind("--log-file=", 0) == 0) {
+            if (!openai::Logger::instance().openFile(arg.substr(11))) {
+                std::cout << "Could not open log file: " << arg.substr(11) << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--mock") {
+            mockServer = std::make_unique<openai::MockServer>();
+            if (!mockServer->start()) {
+                return 1;
+            }
+        }
+    }
+    std::string baseUrl = mockServer ? mockServer->openaiBaseUrl() : "";
+    if (mockServer) {
+        assemblyai::setApiBaseUrl(mockServer->assemblyaiBaseUrl());
+    }
+    if (transcribeSeconds > 0.0) {
+        int result = transcribe(transcribeSeconds, mockServer != nullptr, gateSpeech);
+        if (mockServer) {
+            std::cout << "Mock server: " << mockServer->toJson().dump(2) << std::endl;
+        }
+        fclose(fp);
+        return result;
+    }
+
     openai::SharedData sharedData{ fp };
-    std::thread([&sharedData]{
+    auto bargeIn = std::make_shared<openai::CancellationToken>();
+    sharedData.setCancellationToken(bargeIn);
+    auto speechCache = std::make_shared<openai::SpeechCache>(audioFolderPath / "cache");
+    std::thread speaker([&sharedData, speechCache, baseUrl, format]{
         openai::OpenAI openAI{ }; // Replace with your API key
+        openai::TtsOptions options;
+        options.format = format;
+        openAI.setTtsOptions(options);
+        if (!baseUrl.empty()) {
+            openAI.setBaseUrl(baseUrl);
+        }
+        else {
+            openAI.setSpeechCache(speechCache);
+        }
         openAI.textToSpeech("C plus plus is the best language in the world", &sharedData);
-    }).detach();
+        std::cout << "Pipeline stats: " << sharedData.stats.toJson().dump(2) << std::endl;
+        std::cout << "Stream: " << sharedData.decoder->toJson().dump(2) << std::endl;
+    });
 
-    openai::playAudio(&sharedData);
+    std::thread interrupter;
+    if (bargeInAfterMs >= 0) {
+        interrupter = std::thread([bargeIn, bargeInAfterMs] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(bargeInAfterMs));
+            bargeIn->cancel();
+        });
+    }
+
+    openai::playAudio(&sharedData, *sink);
+    speaker.join();
+    if (interrupter.joinable()) {
+        interrupter.join();
+    }
+    std::cout << "Playback: " << sharedData.playback.toJson().dump(2) << std::endl;
+    std::cout << "Jitter buffer: " << sharedData.jitter.toJson().dump(2) << std::endl;
+    std::cout << "Sink: " << sink->statsJson().dump(2) << std::endl;
+    std::cout << "Latency: " << openai::LatencyRecorder::instance().toJson().dump(2) << std::endl;
+    std::cout << "Logger: " << openai::Logger::instance().toJson().dump(2) << std::endl;
+    std::cout << "Connection pool: " << openai::ConnectionPool::instance().toJson().dump(2) << std::endl;
+    if (mockServer) {
+        std::cout << "Mock server: " << mockServer->toJson().dump(2) << std::endl;
+    }
 
-    // Close the file
+    // Close the file once the archive writer has written everything out
+    sharedData.closeArchive();
+    std::cout << "Archive: " << sharedData.archive->toJson().dump(2) << std::endl;
     fclose(fp);
     return 0;
 }
@@ -14,10 +14,20 @@
 
 #include "ChatStructures.hpp"
 #include "assemblyai.h"
+#define NOMINMAX // Keep windows.h from defining min/max macros that break std::min/std::max
+#define WIN32_LEAN_AND_MEAN // Keep windows.h from pulling in winsock.h, which clashes with winsock2.h
 #include <windows.h>
 // #include "live_player.hpp"
 #include "file_player.hpp"
 #include "openai-reduced.hpp"
+#include "phrase_bank.hpp"
+#include "logging_benchmark.hpp"
+#include "ring_benchmark.hpp"
+#include "sse_benchmark.hpp"
+#include "mock_server.hpp"
+#include "opus_frame_check.hpp"
+#include "realtime_transcriber.hpp"
+#include "speech_capture.hpp"
 #include "nlohmann/json.hpp"
 
 
@@ -0,0 +1,241 @@
+#ifndef ARCHIVE_WRITER_HPP_
+#define ARCHIVE_WRITER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /// @brief When ArchiveWriter forces written data to stable storage
+    enum class SyncPolicy {
+        None,     ///< Leave it to the OS; close() still flushes the stdio buffer
+        OnClose,  ///< fsync once, when the writer is closed
+        OnFlush,  ///< fsync at every flush(), i.e. at the end of every response
+        Periodic  ///< fsync at most once per syncInterval while data is being written, and on close
+    };
+
+    /**
+    * @brief Background writer for the raw response archive
+    *
+    * Buffers are taken by move and queued; a worker thread coalesces them into a staging buffer and
+    * writes whole multiples of BLOCK_SIZE, so the file is written in large block-aligned pieces and
+    * the threads receiving and decoding audio never wait on the disk. Only flush() and close() write
+    * a partial block. If the disk falls behind by more than maxQueuedBytes, new buffers are dropped
+    * and counted rather than stalling the stream.
+    *
+    * The FILE stays owned by the caller, who must close() the writer before closing the file.
+    */
+    class ArchiveWriter {
+    public:
+        static constexpr size_t BLOCK_SIZE = 4096;
+
+        struct Options {
+            size_t batchBytes = 256 * 1024; ///< Staged bytes that trigger a write, rounded down to BLOCK_SIZE
+            size_t maxQueuedBytes = 64 * 1024 * 1024; ///< Backlog above which new buffers are dropped
+            SyncPolicy sync = SyncPolicy::OnClose;
+            std::chrono::milliseconds syncInterval{ 1000 }; ///< Used by SyncPolicy::Periodic
+        };
+
+        explicit ArchiveWriter(FILE* file) : ArchiveWriter(file, Options{}) {}
+
+        ArchiveWriter(FILE* file, Options options)
+            : file_{ file }, options_{ options } {
+            options_.batchBytes = std::max(BLOCK_SIZE, options_.batchBytes / BLOCK_SIZE * BLOCK_SIZE);
+            staging_.reserve(options_.batchBytes + BLOCK_SIZE);
+            lastSync_ = Clock::now();
+            worker_ = std::thread([this] { run(); });
+        }
+
+        ~ArchiveWriter() {
+            close();
+        }
+
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+        /// @brief Queue a buffer for writing; never blocks on the disk
+        /// @return false if the buffer was dropped because the writer is closed or too far behind
+        bool write(std::vector<char>&& buffer) {
+            if (buffer.empty()) {
+                return true;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_ || queuedBytes_ + buffer.size() > options_.maxQueuedBytes) {
+                droppedBytes_ += buffer.size();
+                return false;
+            }
+            queuedBytes_ += buffer.size();
+            maxQueuedBytes_ = std::max(maxQueuedBytes_, queuedBytes_);
+            queue_.push_back(std::move(buffer));
+            cv_.notify_one();
+            return true;
+        }
+
+        /// @brief Ask the worker to write everything queued so far, including a partial block
+        ///
+        /// Returns immediately; with SyncPolicy::OnFlush the data is also synced to disk.
+        void flush() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushRequested_ = true;
+            cv_.notify_one();
+        }
+
+        /// @brief Write and sync everything queued, then stop the worker; later writes are dropped
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+                cv_.notify_one();
+            }
+            if (worker_.joinable()) {
+                worker_.join();
+            }
+        }
+
+        nlohmann::json toJson() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return nlohmann::json{
+                {"bytes_written", bytesWritten_.load()},
+                {"writes", writes_.load()},
+                {"syncs", syncs_.load()},
+                {"write_errors", writeErrors_.load()},
+                {"queued_bytes", queuedBytes_},
+                {"max_queued_bytes", maxQueuedBytes_},
+                {"dropped_bytes", droppedBytes_},
+                {"write_ms", writeNanos_.load() / 1e6},
+                {"sync_ms", syncNanos_.load() / 1e6}
+            };
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /// @brief Worker loop: stage queued buffers and write them out in block multiples
+        void run() {
+            std::deque<std::vector<char>> batch;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                auto wakeUp = [this] { return !queue_.empty() || flushRequested_ || closed_; };
+                if (options_.sync == SyncPolicy::Periodic && dirty_) {
+                    cv_.wait_for(lock, options_.syncInterval, wakeUp);
+                }
+                else {
+                    cv_.wait(lock, wakeUp);
+                }
+                batch.swap(queue_);
+                bool flush = flushRequested_ || closed_;
+                bool closing = closed_;
+                flushRequested_ = false;
+                lock.unlock();
+
+                size_t taken = 0;
+                for (auto& buffer : batch) {
+                    taken += buffer.size();
+                    staging_.insert(staging_.end(), buffer.begin(), buffer.end());
+                    if (staging_.size() >= options_.batchBytes) {
+                        writeStaged(false);
+                    }
+                }
+                batch.clear();
+                writeStaged(flush);
+
+                if (closing) {
+                    std::fflush(file_);
+                    if (options_.sync != SyncPolicy::None && dirty_) {
+                        sync();
+                    }
+                }
+                else if (flush && options_.sync == SyncPolicy::OnFlush && dirty_) {
+                    std::fflush(file_);
+                    sync();
+                }
+                else if (options_.sync == SyncPolicy::Periodic && dirty_ && Clock::now() - lastSync_ >= options_.syncInterval) {
+                    std::fflush(file_);
+                    sync();
+                }
+
+                lock.lock();
+                queuedBytes_ -= taken;
+                if (closing && queue_.empty()) {
+                    return;
+                }
+            }
+        }
+
+        /// @brief Write the staged bytes: every whole block, or everything when `all` is set
+        void writeStaged(bool all) {
+            size_t size = all ? staging_.size() : staging_.size() / BLOCK_SIZE * BLOCK_SIZE;
+            if (size == 0) {
+                return;
+            }
+            auto begin = Clock::now();
+            size_t written = std::fwrite(staging_.data(), 1, size, file_);
+            writeNanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+            if (written != size) {
+                writeErrors_ += 1;
+            }
+            bytesWritten_ += written;
+            writes_ += 1;
+            dirty_ = true;
+            staging_.erase(staging_.begin(), staging_.begin() + size);
+        }
+
+        void sync() {
+            auto begin = Clock::now();
+#ifdef _WIN32
+            _commit(_fileno(file_));
+#else
+            fsync(fileno(file_));
+#endif
+            lastSync_ = Clock::now();
+            syncNanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(lastSync_ - begin).count();
+            syncs_ += 1;
+            dirty_ = false;
+        }
+
+        FILE* file_; ///< Archive file, owned by the caller
+        Options options_;
+
+        mutable std::mutex mutex_; ///< Protects the queue and the fields up to closed_
+        std::condition_variable cv_; ///< Signalled on write(), flush() and close()
+        std::deque<std::vector<char>> queue_; ///< Buffers waiting for the worker
+        size_t queuedBytes_{ 0 }; ///< Bytes handed to write() that the worker has not finished with
+        size_t maxQueuedBytes_{ 0 }; ///< Largest backlog seen
+        size_t droppedBytes_{ 0 }; ///< Bytes dropped because the writer was behind or closed
+        bool flushRequested_{ false };
+        bool closed_{ false };
+
+        // Worker thread only
+        std::vector<char> staging_; ///< Coalesced bytes not yet written
+        bool dirty_{ false }; ///< Data was written since the last sync
+        Clock::time_point lastSync_;
+
+        std::atomic<size_t> bytesWritten_{ 0 };
+        std::atomic<size_t> writes_{ 0 };
+        std::atomic<size_t> syncs_{ 0 };
+        std::atomic<size_t> writeErrors_{ 0 };
+        std::atomic<long long> writeNanos_{ 0 };
+        std::atomic<long long> syncNanos_{ 0 };
+
+        std::thread worker_;
+    };
+
+} // namespace openai
+
+#endif // ARCHIVE_WRITER_HPP_
@@ -1,13 +1,35 @@
 #pragma once
 
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
+#include "connection_pool.hpp"
+#include "logger.hpp"
+
 namespace assemblyai{
 using json = nlohmann::json;
+
+/// @brief Base URL of the AssemblyAI API, overridable with the ASSEMBLYAI_BASE_URL environment variable
+std::string& apiBaseUrl() {
+    static std::string url = [] {
+        const char* env_p = std::getenv("ASSEMBLYAI_BASE_URL");
+        return std::string{ env_p ? env_p : "https://api.assemblyai.com" };
+    }();
+    return url;
+}
+
+/// @brief Send requests to another server, e.g. the local MockServer ("http://127.0.0.1:8080")
+void setApiBaseUrl(const std::string& url) {
+    apiBaseUrl() = url;
+    if (!apiBaseUrl().empty() && apiBaseUrl().back() == '/') {
+        apiBaseUrl().pop_back();
+    }
+}
+
 std::string constructWebSocketUrl(int sampleRate, const std::vector<std::string>& wordBoost) {
     // Construct JSON array for word_boost using nlohmann JSON
     json wordBoostJson = json::array();
@@ -21,7 +43,15 @@ std::string constructWebSocketUrl(int sampleRate, const std::vector<std::string>
     curl_free(encodedWordBoost);
 
     // Construct the URL
-    std::string url = "wss://api.assemblyai.com/v2/realtime/ws?sample_rate=" + std::to_string(sampleRate) + "&word_boost=" + encodedWordBoostStr;
+    // Same host as the REST API, with the matching websocket scheme
+    std::string base = apiBaseUrl();
+    if (base.compare(0, 8, "https://") == 0) {
+        base = "wss://" + base.substr(8);
+    }
+    else if (base.compare(0, 7, "http://") == 0) {
+        base = "ws://" + base.substr(7);
+    }
+    std::string url = base + "/v2/realtime/ws?sample_rate=" + std::to_string(sampleRate) + "&word_boost=" + encodedWordBoostStr;
     return url;
 }
 
@@ -37,39 +67,51 @@ size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s)
     }
 }
 
-std::string fetchToken(const std::string& apiToken) {
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
+/// @brief Request a temporary realtime token valid for `expiresIn` seconds (the API accepts 60 to 360000)
+///
+/// One blocking HTTPS round trip on a pooled connection; prefer a TokenManager, which keeps a token
+/// ready ahead of time.
+/// @return The token, or an empty string if the request failed
+std::string fetchToken(const std::string& apiToken, int expiresIn = 600, long timeoutMs = 10000) {
+    CURL* curl = openai::ConnectionPool::instance().acquire();
+    if (!curl) {
+        return "";
+    }
 
-    curl = curl_easy_init();
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("authorization: " + apiToken).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-
-        json data = { {"expires_in", 3 * 60 * 60} }; // Expire in 3 hours
-        std::string postData = data.dump();
-
-        curl_easy_setopt(curl, CURLOPT_URL, "https://api.assemblyai.com/v2/realtime/token");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-            return "";
-        }
+    std::string readBuffer;
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, ("authorization: " + apiToken).c_str());
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    json data = { {"expires_in", expiresIn} };
+    std::string postData = data.dump();
+
+    std::string url = apiBaseUrl() + "/v2/realtime/token";
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    openai::ConnectionPool::instance().release(curl);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK) {
+        OPENAI_LOG_ERROR("realtime_token_failed", "%s", curl_easy_strerror(res));
+        return "";
     }
-    delete curl;
+
     // Parse JSON response and extract token
-    json response = json::parse(readBuffer);
-    return response["token"];
+    json response = json::parse(readBuffer, nullptr, false);
+    if (status != 200 || !response.is_object() || !response.contains("token") || !response["token"].is_string()) {
+        OPENAI_LOG_ERROR("realtime_token_failed", "HTTP %ld: %.160s", status, readBuffer.c_str());
+        return "";
+    }
+    return response["token"].get<std::string>();
 }
 
 int main() {
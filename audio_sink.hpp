@@ -0,0 +1,330 @@
+#ifndef AUDIO_SINK_HPP_
+#define AUDIO_SINK_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <portaudio.h>
+
+#include "logger.hpp"
+
+namespace openai {
+
+    /// @brief Format of the stream a sink pulls from its callback
+    struct StreamFormat {
+        int channels;
+        double sampleRate;
+        unsigned long framesPerBuffer;
+    };
+
+    /**
+    * @brief Destination of rendered audio, driving a PortAudio-style callback
+    *
+    * Every sink calls the same PaStreamCallback the sound card would, so the decode, buffer and
+    * callback path behaves identically whether it is played, paced against a simulated clock or
+    * rendered to a file. The callback returning paComplete (or stop()) ends the stream.
+    */
+    class AudioSink {
+    public:
+        /// @brief Counters of the callbacks the sink has driven
+        struct Stats {
+            size_t callbacks; ///< Number of callback invocations
+            size_t frames; ///< Frames requested from the callback
+            size_t lateCallbacks; ///< Callbacks that started after their device deadline (paced sinks only)
+            double maxCallbackMs; ///< Longest single callback
+            double totalCallbackMs; ///< Time spent inside the callback
+        };
+
+        virtual ~AudioSink() = default;
+
+        /// @brief Open the sink and start pulling audio from `callback`
+        /// @return false if the sink could not be started
+        virtual bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) = 0;
+
+        /// @brief Stop pulling audio and close the sink; safe to call more than once
+        virtual void stop() = 0;
+
+        /// @brief Whether the sink is still pulling audio
+        virtual bool isActive() const = 0;
+
+        virtual const char* name() const = 0;
+
+        /// @brief Block until the callback completes the stream or stop() is called
+        void waitUntilDone() const {
+            while (isActive()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        Stats stats() const {
+            return Stats{ callbacks_.load(), frames_.load(), lateCallbacks_.load(), maxCallbackNanos_.load() / 1e6, totalCallbackNanos_.load() / 1e6 };
+        }
+
+        nlohmann::json statsJson() const {
+            Stats s = stats();
+            return nlohmann::json{
+                {"sink", name()},
+                {"callbacks", s.callbacks},
+                {"frames", s.frames},
+                {"late_callbacks", s.lateCallbacks},
+                {"max_callback_ms", s.maxCallbackMs},
+                {"total_callback_ms", s.totalCallbackMs}
+            };
+        }
+
+    protected:
+        /// @brief Invoke the callback once for `frames` frames, timing it
+        int render(PaStreamCallback* callback, void* userData, float* out, unsigned long frames) {
+            auto begin = std::chrono::steady_clock::now();
+            int result = callback(nullptr, out, frames, nullptr, 0, userData);
+            long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+            callbacks_ += 1;
+            frames_ += frames;
+            totalCallbackNanos_ += nanos;
+            long long longest = maxCallbackNanos_.load(std::memory_order_relaxed);
+            while (nanos > longest && !maxCallbackNanos_.compare_exchange_weak(longest, nanos)) {}
+            return result;
+        }
+
+        void resetStats() {
+            callbacks_ = 0;
+            frames_ = 0;
+            lateCallbacks_ = 0;
+            maxCallbackNanos_ = 0;
+            totalCallbackNanos_ = 0;
+        }
+
+        std::atomic<size_t> callbacks_{ 0 };
+        std::atomic<size_t> frames_{ 0 };
+        std::atomic<size_t> lateCallbacks_{ 0 };
+        std::atomic<long long> maxCallbackNanos_{ 0 };
+        std::atomic<long long> totalCallbackNanos_{ 0 };
+    };
+
+    /// @brief Plays through the default PortAudio output device
+    class PortAudioSink : public AudioSink {
+    public:
+        ~PortAudioSink() override {
+            stop();
+        }
+
+        bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) override {
+            // Initialize PortAudio
+            PaError err = Pa_Initialize();
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_init_failed", "%s", Pa_GetErrorText(err));
+                return false;
+            }
+
+            // Open PortAudio stream
+            err = Pa_OpenDefaultStream(&stream_, 0, format.channels, paFloat32, format.sampleRate, format.framesPerBuffer, callback, userData);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_open_failed", "%s", Pa_GetErrorText(err));
+                stream_ = nullptr;
+                Pa_Terminate();
+                return false;
+            }
+
+            // Start PortAudio stream for playback
+            err = Pa_StartStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_start_failed", "%s", Pa_GetErrorText(err));
+                Pa_CloseStream(stream_);
+                stream_ = nullptr;
+                Pa_Terminate();
+                return false;
+            }
+            return true;
+        }
+
+        void stop() override {
+            if (stream_ == nullptr) {
+                return;
+            }
+
+            // Stop and close PortAudio stream
+            PaError err = Pa_StopStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_stop_failed", "%s", Pa_GetErrorText(err));
+            }
+            err = Pa_CloseStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_close_failed", "%s", Pa_GetErrorText(err));
+            }
+            stream_ = nullptr;
+
+            // Terminate PortAudio
+            Pa_Terminate();
+        }
+
+        bool isActive() const override {
+            return stream_ != nullptr && Pa_IsStreamActive(stream_) == 1;
+        }
+
+        const char* name() const override { return "portaudio"; }
+
+    private:
+        PaStream* stream_{ nullptr }; ///< Open output stream, nullptr when stopped
+    };
+
+    /**
+    * @brief Headless sink that calls the callback on a simulated device clock
+    *
+    * One buffer is rendered every framesPerBuffer / sampleRate seconds against absolute deadlines, as
+    * a sound card would, and the output is discarded. Callbacks that start after their deadline are
+    * counted as late.
+    */
+    class NullSink : public AudioSink {
+    public:
+        ~NullSink() override {
+            stop();
+        }
+
+        bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) override {
+            stop();
+            resetStats();
+            running_ = true;
+            thread_ = std::thread([this, format, callback, userData] {
+                std::vector<float> buffer(format.framesPerBuffer * format.channels);
+                auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(format.framesPerBuffer / format.sampleRate));
+                auto deadline = std::chrono::steady_clock::now();
+                while (running_) {
+                    if (std::chrono::steady_clock::now() > deadline + period / 2) {
+                        lateCallbacks_ += 1;
+                    }
+                    if (render(callback, userData, buffer.data(), format.framesPerBuffer) != paContinue) {
+                        break;
+                    }
+                    deadline += period;
+                    std::this_thread::sleep_until(deadline);
+                }
+                running_ = false;
+            });
+            return true;
+        }
+
+        void stop() override {
+            running_ = false;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        bool isActive() const override { return running_; }
+
+        const char* name() const override { return "null"; }
+
+    private:
+        std::thread thread_; ///< Simulated device thread
+        std::atomic<bool> running_{ false };
+    };
+
+    /**
+    * @brief Headless sink that renders as fast as possible into a 32-bit float WAV file
+    *
+    * Useful for regression tests and throughput benchmarks; pass an empty path to discard the audio.
+    */
+    class WavFileSink : public AudioSink {
+    public:
+        explicit WavFileSink(const std::string& path) : path_{ path } {}
+
+        ~WavFileSink() override {
+            stop();
+        }
+
+        bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) override {
+            stop();
+            resetStats();
+            if (!path_.empty()) {
+                file_ = std::fopen(path_.c_str(), "wb");
+                if (!file_) {
+                    OPENAI_LOG_ERROR("wav_sink_open_failed", "Could not open %s for writing", path_.c_str());
+                    return false;
+                }
+                writeHeader(format, 0);
+            }
+            running_ = true;
+            thread_ = std::thread([this, format, callback, userData] {
+                std::vector<float> buffer(format.framesPerBuffer * format.channels);
+                uint32_t dataBytes = 0;
+                while (running_) {
+                    int result = render(callback, userData, buffer.data(), format.framesPerBuffer);
+                    if (file_) {
+                        dataBytes += static_cast<uint32_t>(std::fwrite(buffer.data(), sizeof(float), buffer.size(), file_) * sizeof(float));
+                    }
+                    if (result != paContinue) {
+                        break;
+                    }
+                }
+                if (file_) {
+                    writeHeader(format, dataBytes);
+                    std::fclose(file_);
+                    file_ = nullptr;
+                }
+                running_ = false;
+            });
+            return true;
+        }
+
+        void stop() override {
+            running_ = false;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        bool isActive() const override { return running_; }
+
+        const char* name() const override { return "wav"; }
+
+    private:
+        /// @brief Write (or rewrite) the RIFF header for an IEEE float WAV with `dataBytes` of samples
+        void writeHeader(const StreamFormat& format, uint32_t dataBytes) {
+            const uint16_t formatTag = 3; // WAVE_FORMAT_IEEE_FLOAT
+            const uint16_t channels = static_cast<uint16_t>(format.channels);
+            const uint32_t sampleRate = static_cast<uint32_t>(format.sampleRate);
+            const uint16_t blockAlign = static_cast<uint16_t>(channels * sizeof(float));
+            const uint32_t byteRate = sampleRate * blockAlign;
+            const uint16_t bitsPerSample = 32;
+            const uint16_t extensionSize = 0;
+            const uint32_t fmtSize = 18;
+            const uint32_t factSize = 4;
+            const uint32_t frames = blockAlign > 0 ? dataBytes / blockAlign : 0;
+            const uint32_t riffSize = 4 + (8 + fmtSize) + (8 + factSize) + (8 + dataBytes);
+
+            std::fseek(file_, 0, SEEK_SET);
+            std::fwrite("RIFF", 1, 4, file_);
+            std::fwrite(&riffSize, 4, 1, file_);
+            std::fwrite("WAVEfmt ", 1, 8, file_);
+            std::fwrite(&fmtSize, 4, 1, file_);
+            std::fwrite(&formatTag, 2, 1, file_);
+            std::fwrite(&channels, 2, 1, file_);
+            std::fwrite(&sampleRate, 4, 1, file_);
+            std::fwrite(&byteRate, 4, 1, file_);
+            std::fwrite(&blockAlign, 2, 1, file_);
+            std::fwrite(&bitsPerSample, 2, 1, file_);
+            std::fwrite(&extensionSize, 2, 1, file_);
+            std::fwrite("fact", 1, 4, file_);
+            std::fwrite(&factSize, 4, 1, file_);
+            std::fwrite(&frames, 4, 1, file_);
+            std::fwrite("data", 1, 4, file_);
+            std::fwrite(&dataBytes, 4, 1, file_);
+            std::fseek(file_, 0, SEEK_END);
+        }
+
+        std::string path_; ///< Output file, empty to discard
+        FILE* file_{ nullptr };
+        std::thread thread_; ///< Render thread
+        std::atomic<bool> running_{ false };
+    };
+
+} // namespace openai
+
+#endif // AUDIO_SINK_HPP_
@@ -0,0 +1,197 @@
+#ifndef AUDIO_SOURCE_HPP_
+#define AUDIO_SOURCE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <portaudio.h>
+
+#include "audio_sink.hpp"
+#include "logger.hpp"
+
+namespace openai {
+
+    /**
+    * @brief Origin of captured audio, driving a PortAudio-style input callback
+    *
+    * The counterpart of AudioSink: every source calls the same PaStreamCallback with captured 32-bit
+    * float frames in `inputBuffer` (and no output buffer), so capture, VAD and upload behave the same
+    * whether they are fed by a microphone or by a synthetic signal on a simulated clock. The callback
+    * returning paComplete (or stop()) ends the stream.
+    */
+    class AudioSource {
+    public:
+        virtual ~AudioSource() = default;
+
+        /// @brief Open the source and start pushing captured audio to `callback`
+        /// @return false if the source could not be started
+        virtual bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) = 0;
+
+        /// @brief Stop capturing and close the source; safe to call more than once
+        virtual void stop() = 0;
+
+        /// @brief Whether the source is still capturing
+        virtual bool isActive() const = 0;
+
+        virtual const char* name() const = 0;
+
+        nlohmann::json statsJson() const {
+            return nlohmann::json{
+                {"source", name()},
+                {"callbacks", callbacks_.load()},
+                {"frames", frames_.load()}
+            };
+        }
+
+    protected:
+        /// @brief Hand one captured buffer to the callback
+        int capture(PaStreamCallback* callback, void* userData, const float* in, unsigned long frames) {
+            callbacks_ += 1;
+            frames_ += frames;
+            return callback(in, nullptr, frames, nullptr, 0, userData);
+        }
+
+        std::atomic<size_t> callbacks_{ 0 };
+        std::atomic<size_t> frames_{ 0 };
+    };
+
+    /// @brief Captures from the default PortAudio input device
+    class PortAudioSource : public AudioSource {
+    public:
+        ~PortAudioSource() override {
+            stop();
+        }
+
+        bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) override {
+            stop();
+            PaError err = Pa_Initialize();
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_init_failed", "%s", Pa_GetErrorText(err));
+                return false;
+            }
+
+            callback_ = callback;
+            userData_ = userData;
+            err = Pa_OpenDefaultStream(&stream_, format.channels, 0, paFloat32, format.sampleRate, format.framesPerBuffer, &PortAudioSource::onInput, this);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_open_failed", "Input stream: %s", Pa_GetErrorText(err));
+                stream_ = nullptr;
+                Pa_Terminate();
+                return false;
+            }
+
+            err = Pa_StartStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_start_failed", "Input stream: %s", Pa_GetErrorText(err));
+                Pa_CloseStream(stream_);
+                stream_ = nullptr;
+                Pa_Terminate();
+                return false;
+            }
+            return true;
+        }
+
+        void stop() override {
+            if (stream_ == nullptr) {
+                return;
+            }
+            PaError err = Pa_StopStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_stop_failed", "Input stream: %s", Pa_GetErrorText(err));
+            }
+            err = Pa_CloseStream(stream_);
+            if (err != paNoError) {
+                OPENAI_LOG_ERROR("portaudio_close_failed", "Input stream: %s", Pa_GetErrorText(err));
+            }
+            stream_ = nullptr;
+            Pa_Terminate();
+        }
+
+        bool isActive() const override {
+            return stream_ != nullptr && Pa_IsStreamActive(stream_) == 1;
+        }
+
+        const char* name() const override { return "portaudio"; }
+
+    private:
+        static int onInput(const void* inputBuffer, void*, unsigned long frames,
+            const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void* userData) {
+            auto* self = static_cast<PortAudioSource*>(userData);
+            return self->capture(self->callback_, self->userData_, static_cast<const float*>(inputBuffer), frames);
+        }
+
+        PaStream* stream_{ nullptr }; ///< Open input stream, nullptr when stopped
+        PaStreamCallback* callback_{ nullptr };
+        void* userData_{ nullptr };
+    };
+
+    /**
+    * @brief Headless source that plays a recorded or synthesized signal into the callback
+    *
+    * One buffer is captured every framesPerBuffer / sampleRate seconds against absolute deadlines, as
+    * a sound card would. Once the signal is exhausted the source keeps delivering silence until it is
+    * stopped, or completes the stream if `stopAtEnd` is set. Used to measure the capture path offline.
+    */
+    class SyntheticSource : public AudioSource {
+    public:
+        /// @param signal Interleaved samples at the rate and channel count passed to start()
+        explicit SyntheticSource(std::vector<float> signal, bool stopAtEnd = false)
+            : signal_{ std::move(signal) }, stopAtEnd_{ stopAtEnd } {}
+
+        ~SyntheticSource() override {
+            stop();
+        }
+
+        bool start(const StreamFormat& format, PaStreamCallback* callback, void* userData) override {
+            stop();
+            running_ = true;
+            thread_ = std::thread([this, format, callback, userData] {
+                std::vector<float> buffer(format.framesPerBuffer * format.channels);
+                auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(format.framesPerBuffer / format.sampleRate));
+                auto deadline = std::chrono::steady_clock::now() + period; // A buffer is delivered once it has been "recorded"
+                size_t position = 0;
+                while (running_) {
+                    std::this_thread::sleep_until(deadline);
+                    if (stopAtEnd_ && position >= signal_.size()) {
+                        break;
+                    }
+                    size_t n = std::min(buffer.size(), signal_.size() - position);
+                    std::copy(signal_.begin() + position, signal_.begin() + position + n, buffer.begin());
+                    std::fill(buffer.begin() + n, buffer.end(), 0.0f);
+                    position += n;
+                    if (capture(callback, userData, buffer.data(), format.framesPerBuffer) != paContinue) {
+                        break;
+                    }
+                    deadline += period;
+                }
+                running_ = false;
+            });
+            return true;
+        }
+
+        void stop() override {
+            running_ = false;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        bool isActive() const override { return running_; }
+
+        const char* name() const override { return "synthetic"; }
+
+    private:
+        std::vector<float> signal_; ///< Samples to deliver, then silence
+        bool stopAtEnd_; ///< Complete the stream once the signal has been delivered
+        std::thread thread_; ///< Simulated device thread
+        std::atomic<bool> running_{ false };
+    };
+
+} // namespace openai
+
+#endif // AUDIO_SOURCE_HPP_
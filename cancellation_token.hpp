@@ -0,0 +1,88 @@
+#ifndef CANCELLATION_TOKEN_HPP_
+#define CANCELLATION_TOKEN_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace openai {
+
+    /**
+    * @brief One-shot cancellation signal shared by every stage working on the same utterance
+    *
+    * Stages register what to do on cancellation (abort a transfer, interrupt a stream, stop a
+    * pipeline); cancel() runs all of them once, on the calling thread. A listener registered after
+    * cancellation runs immediately, so a request that starts late is still stopped. Typically
+    * cancelled when a UserTranscription message arrives while speech is playing (barge-in).
+    */
+    class CancellationToken {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Listener = std::function<void()>;
+
+        CancellationToken() = default;
+        CancellationToken(const CancellationToken&) = delete;
+        CancellationToken& operator=(const CancellationToken&) = delete;
+
+        /// @brief Run `listener` on cancellation, or right away if the token is already cancelled
+        /// @return Id to pass to removeListener(), 0 if the listener has already run
+        size_t addListener(Listener listener) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!cancelled_) {
+                    listeners_.emplace_back(++lastId_, std::move(listener));
+                    return lastId_;
+                }
+            }
+            listener();
+            return 0;
+        }
+
+        /// @brief Unregister a listener whose target is going away; waits if cancel() is running it
+        void removeListener(size_t id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = listeners_.begin(); it != listeners_.end(); ++it) {
+                if (it->first == id) {
+                    listeners_.erase(it);
+                    return;
+                }
+            }
+        }
+
+        /// @brief Cancel and run every listener; later calls do nothing
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_) {
+                return;
+            }
+            cancelledAt_ = Clock::now();
+            cancelled_ = true;
+            // Listeners run under the lock so removeListener() cannot return while its target is in use
+            for (auto& listener : listeners_) {
+                listener.second();
+            }
+            listeners_.clear();
+        }
+
+        bool isCancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+        /// @brief When cancel() was first called; only meaningful once isCancelled()
+        Clock::time_point cancelledAt() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return cancelledAt_;
+        }
+
+    private:
+        mutable std::mutex mutex_; ///< Protects the listeners and cancelledAt_
+        std::vector<std::pair<size_t, Listener>> listeners_;
+        size_t lastId_{ 0 };
+        std::atomic<bool> cancelled_{ false };
+        Clock::time_point cancelledAt_;
+    };
+
+} // namespace openai
+
+#endif // CANCELLATION_TOKEN_HPP_
@@ -0,0 +1,167 @@
+#ifndef CONNECTION_POOL_HPP_
+#define CONNECTION_POOL_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /**
+    * @brief Process-wide pool of curl easy handles sharing one connection cache
+    *
+    * Every handle handed out is attached to the same curl share handle, so DNS results, TLS sessions
+    * and open connections survive across requests, Sessions and OpenAI objects. Idle easy handles are
+    * kept around and reset between uses instead of being destroyed.
+    */
+    class ConnectionPool {
+    public:
+        /// @brief Counters describing how often warm connections were reused
+        struct Stats {
+            size_t transfers; ///< Completed transfers
+            size_t reusedTransfers; ///< Transfers that did not open a new connection
+            size_t connectionsOpened; ///< New connections (TCP + TLS handshakes) performed
+            double handshakeSeconds; ///< Total time spent connecting and in TLS handshakes
+        };
+
+        /// @brief Get the pool shared by the whole process
+        static ConnectionPool& instance() {
+            static ConnectionPool pool;
+            return pool;
+        }
+
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+        /// @brief Take an easy handle from the pool, configured for keep-alive, HTTP/2 and the shared cache
+        CURL* acquire() {
+            CURL* curl = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!idle_.empty()) {
+                    curl = idle_.back();
+                    idle_.pop_back();
+                }
+            }
+            if (curl == nullptr) {
+                curl = curl_easy_init();
+                if (curl == nullptr) {
+                    return nullptr;
+                }
+            }
+            applyDefaults(curl);
+            return curl;
+        }
+
+        /// @brief Return a handle to the pool after a transfer, recording whether its connection was reused
+        /// @param performed Whether a transfer was attempted on the handle since acquire()
+        void release(CURL* curl, bool performed = true) {
+            if (curl == nullptr) {
+                return;
+            }
+            if (performed) {
+                record(curl);
+            }
+            curl_easy_reset(curl); // Keeps the connection cache, DNS cache and TLS sessions
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.push_back(curl);
+        }
+
+        CURLSH* share() const { return share_; }
+
+        Stats stats() const {
+            return Stats{ transfers_.load(), reused_.load(), connectionsOpened_.load(), handshakeMicros_.load() / 1e6 };
+        }
+
+        /// @brief Connection reuse metrics as JSON
+        nlohmann::json toJson() const {
+            Stats s = stats();
+            size_t opened = s.connectionsOpened;
+            double averageHandshake = opened > 0 ? s.handshakeSeconds / opened : 0.0;
+            return nlohmann::json{
+                {"transfers", s.transfers},
+                {"reused_transfers", s.reusedTransfers},
+                {"reuse_rate", s.transfers > 0 ? static_cast<double>(s.reusedTransfers) / s.transfers : 0.0},
+                {"connections_opened", opened},
+                {"handshakes_saved", s.reusedTransfers},
+                {"estimated_seconds_saved", averageHandshake * s.reusedTransfers}
+            };
+        }
+
+    private:
+        ConnectionPool() {
+            curl_global_init(CURL_GLOBAL_ALL);
+
+            share_ = curl_share_init();
+            curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lockCallback);
+            curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlockCallback);
+            curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        }
+
+        ~ConnectionPool() {
+            for (CURL* curl : idle_) {
+                curl_easy_cleanup(curl);
+            }
+            curl_share_cleanup(share_);
+            curl_global_cleanup();
+        }
+
+        void applyDefaults(CURL* curl) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L); // Prefer multiplexing on an existing HTTP/2 connection
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+
+            // Ignore SSL
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        }
+
+        void record(CURL* curl) {
+            long newConnections = 0;
+            curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &newConnections);
+            transfers_ += 1;
+            if (newConnections == 0) {
+                reused_ += 1;
+                return;
+            }
+            connectionsOpened_ += newConnections;
+            curl_off_t appConnectMicros = 0;
+            curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnectMicros);
+            if (appConnectMicros == 0) { // Plain HTTP: only the TCP connect happened
+                curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &appConnectMicros);
+            }
+            handshakeMicros_ += static_cast<long long>(appConnectMicros);
+        }
+
+        static void lockCallback(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+            static_cast<ConnectionPool*>(userptr)->shareLocks_[data].lock();
+        }
+
+        static void unlockCallback(CURL*, curl_lock_data data, void* userptr) {
+            static_cast<ConnectionPool*>(userptr)->shareLocks_[data].unlock();
+        }
+
+        CURLSH* share_{ nullptr }; ///< Share handle holding the DNS, TLS session and connection caches
+        std::mutex shareLocks_[CURL_LOCK_DATA_LAST]; ///< One lock per kind of shared data
+
+        std::mutex mutex_; ///< Protects idle_
+        std::vector<CURL*> idle_; ///< Easy handles ready to be reused
+
+        std::atomic<size_t> transfers_{ 0 };
+        std::atomic<size_t> reused_{ 0 };
+        std::atomic<size_t> connectionsOpened_{ 0 };
+        std::atomic<long long> handshakeMicros_{ 0 };
+    };
+
+} // namespace openai
+
+#endif // CONNECTION_POOL_HPP_
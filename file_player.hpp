@@ -14,15 +14,6 @@ const int FRAMES_PER_BUFFER_MP3 = 256;
 #include "openai-reduced.hpp"
 
 
-// Function to initialize PortAudio
-PaError initPortAudio(PaStream** playback_stream) {
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio initialization error: " << Pa_GetErrorText(err) << std::endl;
-    }
-    return err;
-}
-
 // Define PortAudio callback function to play audio
 static int audioCallback(const void* inputBuffer, void* outputBuffer,
     unsigned long framesPerBuffer,
@@ -38,8 +29,8 @@ static int audioCallback(const void* inputBuffer, void* outputBuffer,
     return paContinue;
 }
 
-// Function to play an audio file using libsndfile and PortAudio
-void playAudioFile(const char* filePath) {
+// Function to play an audio file using libsndfile on the given sink (the default output device if none)
+void playAudioFile(const char* filePath, openai::AudioSink* sink = nullptr) {
     SF_INFO sfinfo;
     SNDFILE* sndfile = sf_open(filePath, SFM_READ, &sfinfo);
     if (!sndfile) {
@@ -47,56 +38,17 @@ void playAudioFile(const char* filePath) {
         return;
     }
 
-    // Initialize PortAudio
-    PaStream* stream = nullptr;
-    PaError err = initPortAudio(&stream);
-    if (err != paNoError) {
-        sf_close(sndfile);
-        return;
+    openai::PortAudioSink defaultSink;
+    if (sink == nullptr) {
+        sink = &defaultSink;
     }
 
-    // Open PortAudio stream
-    err = Pa_OpenDefaultStream(&stream, 0, sfinfo.channels, paFloat32, SAMPLE_RATE_MP3, FRAMES_PER_BUFFER_MP3, audioCallback, sndfile);
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream open error: " << Pa_GetErrorText(err) << std::endl;
-        Pa_Terminate();
-        sf_close(sndfile);
-        return;
+    // Play until the callback reaches the end of the file
+    openai::StreamFormat format{ sfinfo.channels, static_cast<double>(sfinfo.samplerate), FRAMES_PER_BUFFER_MP3 };
+    if (sink->start(format, audioCallback, sndfile)) {
+        sink->waitUntilDone();
+        sink->stop();
     }
 
-    // Start PortAudio stream for playback
-    err = Pa_StartStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream start error: " << Pa_GetErrorText(err) << std::endl;
-        Pa_CloseStream(stream);
-        Pa_Terminate();
-        sf_close(sndfile);
-        return;
-    }
-
-    // Wait for user input to stop playback (you can implement your own stop mechanism)
-    std::cout << "Press Enter to stop playback..." << std::endl;
-    std::cin.get();
-
-    // Stop and close PortAudio stream
-    err = Pa_StopStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream stop error: " << Pa_GetErrorText(err) << std::endl;
-        sf_close(sndfile);
-        Pa_Terminate();
-        return;
-    }
-
-    err = Pa_CloseStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio stream close error: " << Pa_GetErrorText(err) << std::endl;
-        sf_close(sndfile);
-        Pa_Terminate();
-        return;
-    }
-
-    // Terminate PortAudio and close the audio file
-    Pa_Terminate();
+    sf_close(sndfile);
 }
-
-
@@ -0,0 +1,212 @@
+#ifndef LATENCY_HISTOGRAM_HPP_
+#define LATENCY_HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /// @brief Milestones of one speech request, in nanoseconds since textToSpeech was called (-1 if never reached)
+    struct LatencyTrace {
+        long long requestSent{ -1 }; ///< The transfer was handed to curl
+        long long firstByte{ -1 }; ///< First response bytes reached the decoder queue
+        long long firstPage{ -1 }; ///< First complete Ogg page was demuxed
+        long long firstPacket{ -1 }; ///< First Opus packet was decoded into the ring buffer
+        long long firstAudio{ -1 }; ///< The audio callback first pulled decoded PCM (time to first audio)
+        long long lastAudio{ -1 }; ///< The audio callback pulled the last sample of the response
+        long long interrupt{ -1 }; ///< The response was interrupted (barge-in)
+        long long silenced{ -1 }; ///< Output had faded to silence after the interruption
+
+        /// @brief Time from interruption to silence, -1 if the response was not interrupted
+        long long bargeIn() const {
+            return interrupt >= 0 && silenced >= 0 ? silenced - interrupt : -1;
+        }
+
+        nlohmann::json toJson() const {
+            auto ms = [](long long nanos) { return nanos < 0 ? nlohmann::json(nullptr) : nlohmann::json(nanos / 1e6); };
+            return nlohmann::json{
+                {"request_sent_ms", ms(requestSent)},
+                {"first_byte_ms", ms(firstByte)},
+                {"first_page_ms", ms(firstPage)},
+                {"first_packet_ms", ms(firstPacket)},
+                {"first_audio_ms", ms(firstAudio)},
+                {"last_audio_ms", ms(lastAudio)},
+                {"barge_in_ms", ms(bargeIn())}
+            };
+        }
+    };
+
+    /**
+    * @brief Lock-free latency histogram with HDR-style log-linear buckets
+    *
+    * Values are recorded in microseconds. Below 64 us every value has its own bucket; above that each
+    * power of two is split into 32 linear sub-buckets, so any recorded value is reported within about
+    * 3% while the whole range from 1 us to hours fits in a fixed array. Recording is a handful of
+    * relaxed atomic increments and never allocates.
+    */
+    class LatencyHistogram {
+    public:
+        /// @brief Record one value in microseconds
+        void record(uint64_t micros) {
+            counts_[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(micros, std::memory_order_relaxed);
+            uint64_t current = max_.load(std::memory_order_relaxed);
+            while (micros > current && !max_.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {}
+            current = min_.load(std::memory_order_relaxed);
+            while (micros < current && !min_.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {}
+        }
+
+        /// @brief Record a duration given in nanoseconds; negative (unreached) values are ignored
+        void recordNanos(long long nanos) {
+            if (nanos >= 0) {
+                record(static_cast<uint64_t>(nanos / 1000));
+            }
+        }
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+        /// @brief Value at `percentile` (0-100), reported as the upper bound of its bucket
+        uint64_t percentile(double percentile) const {
+            uint64_t total = count();
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * total)));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += counts_[i].load(std::memory_order_relaxed);
+                if (seen >= target) {
+                    return std::min(upperBoundOf(i), max_.load(std::memory_order_relaxed));
+                }
+            }
+            return max_.load(std::memory_order_relaxed);
+        }
+
+        void reset() {
+            for (auto& bucket : counts_) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            count_ = 0;
+            sum_ = 0;
+            min_ = UINT64_MAX;
+            max_ = 0;
+        }
+
+        /// @brief Summary in milliseconds
+        nlohmann::json toJson() const {
+            uint64_t total = count();
+            if (total == 0) {
+                return nlohmann::json{ {"count", 0} };
+            }
+            return nlohmann::json{
+                {"count", total},
+                {"min_ms", min_.load() / 1e3},
+                {"mean_ms", static_cast<double>(sum_.load()) / total / 1e3},
+                {"p50_ms", percentile(50) / 1e3},
+                {"p95_ms", percentile(95) / 1e3},
+                {"p99_ms", percentile(99) / 1e3},
+                {"p999_ms", percentile(99.9) / 1e3},
+                {"max_ms", max_.load() / 1e3}
+            };
+        }
+
+    private:
+        static constexpr unsigned SUB_BUCKET_BITS = 5; ///< 32 sub-buckets per power of two
+        static constexpr uint64_t SUB_BUCKETS = uint64_t{ 1 } << SUB_BUCKET_BITS;
+        static constexpr unsigned MAGNITUDES = 32; ///< Values up to 2^38 us (about 76 hours)
+        static constexpr size_t BUCKETS = 2 * SUB_BUCKETS + MAGNITUDES * SUB_BUCKETS;
+
+        static size_t bucketOf(uint64_t value) {
+            if (value < 2 * SUB_BUCKETS) {
+                return static_cast<size_t>(value);
+            }
+            unsigned log2 = 0;
+            for (uint64_t v = value; v > 1; v >>= 1) {
+                ++log2;
+            }
+            unsigned magnitude = log2 - SUB_BUCKET_BITS;
+            if (magnitude > MAGNITUDES) {
+                return BUCKETS - 1;
+            }
+            return static_cast<size_t>(2 * SUB_BUCKETS + (magnitude - 1) * SUB_BUCKETS + ((value >> magnitude) - SUB_BUCKETS));
+        }
+
+        static uint64_t upperBoundOf(size_t index) {
+            if (index < 2 * SUB_BUCKETS) {
+                return index;
+            }
+            uint64_t magnitude = (index - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+            uint64_t sub = (index - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+            return ((sub + 1) << magnitude) - 1;
+        }
+
+        std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<uint64_t> sum_{ 0 };
+        std::atomic<uint64_t> min_{ UINT64_MAX };
+        std::atomic<uint64_t> max_{ 0 };
+    };
+
+    /// @brief Process-wide histograms of every milestone of the speech requests played so far
+    class LatencyRecorder {
+    public:
+        static LatencyRecorder& instance() {
+            static LatencyRecorder recorder;
+            return recorder;
+        }
+
+        void record(const LatencyTrace& trace) {
+            requestSent_.recordNanos(trace.requestSent);
+            firstByte_.recordNanos(trace.firstByte);
+            firstPage_.recordNanos(trace.firstPage);
+            firstPacket_.recordNanos(trace.firstPacket);
+            firstAudio_.recordNanos(trace.firstAudio);
+            lastAudio_.recordNanos(trace.lastAudio);
+            bargeIn_.recordNanos(trace.bargeIn());
+        }
+
+        /// @brief Time to first audio, the latency our SLA is written against
+        const LatencyHistogram& timeToFirstAudio() const { return firstAudio_; }
+
+        /// @brief Time from an interruption to silence at the output, the barge-in budget is 50 ms
+        const LatencyHistogram& bargeIn() const { return bargeIn_; }
+
+        void reset() {
+            for (LatencyHistogram* histogram : { &requestSent_, &firstByte_, &firstPage_, &firstPacket_, &firstAudio_, &lastAudio_, &bargeIn_ }) {
+                histogram->reset();
+            }
+        }
+
+        nlohmann::json toJson() const {
+            return nlohmann::json{
+                {"request_sent", requestSent_.toJson()},
+                {"first_byte", firstByte_.toJson()},
+                {"first_page", firstPage_.toJson()},
+                {"first_packet", firstPacket_.toJson()},
+                {"first_audio", firstAudio_.toJson()},
+                {"last_audio", lastAudio_.toJson()},
+                {"barge_in", bargeIn_.toJson()}
+            };
+        }
+
+    private:
+        LatencyRecorder() = default;
+
+        LatencyHistogram requestSent_;
+        LatencyHistogram firstByte_;
+        LatencyHistogram firstPage_;
+        LatencyHistogram firstPacket_;
+        LatencyHistogram firstAudio_;
+        LatencyHistogram lastAudio_;
+        LatencyHistogram bargeIn_;
+    };
+
+} // namespace openai
+
+#endif // LATENCY_HISTOGRAM_HPP_
@@ -0,0 +1,315 @@
+#ifndef LOGGER_HPP_
+#define LOGGER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Compile-time log levels: statements below OPENAI_LOG_LEVEL expand to nothing, arguments included
+#define OPENAI_LOG_LEVEL_TRACE 0
+#define OPENAI_LOG_LEVEL_DEBUG 1
+#define OPENAI_LOG_LEVEL_INFO 2
+#define OPENAI_LOG_LEVEL_WARN 3
+#define OPENAI_LOG_LEVEL_ERROR 4
+#define OPENAI_LOG_LEVEL_OFF 5
+
+#ifndef OPENAI_LOG_LEVEL
+#define OPENAI_LOG_LEVEL OPENAI_LOG_LEVEL_INFO
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define OPENAI_LOG_PRINTF(formatIndex, firstArg) __attribute__((format(printf, formatIndex, firstArg)))
+#else
+#define OPENAI_LOG_PRINTF(formatIndex, firstArg)
+#endif
+
+namespace openai {
+
+    enum class LogLevel : uint8_t { Trace, Debug, Info, Warn, Error, Off };
+
+    inline const char* logLevelToString(LogLevel level) {
+        switch (level) {
+        case LogLevel::Trace: return "trace";
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warn: return "warn";
+        case LogLevel::Error: return "error";
+        case LogLevel::Off: return "off";
+        }
+        return "unknown";
+    }
+
+    /**
+    * @brief Leveled, structured logger that never blocks the thread that logs
+    *
+    * Every logging thread formats its record into its own single-producer ring of fixed-size slots;
+    * a background sink drains the rings and writes one JSON object per line ("ts_us", "level",
+    * "thread", "event", "msg"). Logging takes no lock and does not allocate, so it is safe in curl
+    * callbacks and decode workers. A full ring drops the record and counts it instead of waiting.
+    * Nothing may be logged from the audio callback; use PlaybackStats counters there.
+    *
+    * Use the OPENAI_LOG_* macros: levels below OPENAI_LOG_LEVEL are compiled out, and the rest cost
+    * one relaxed load while below the runtime level.
+    */
+    class Logger {
+    public:
+        static constexpr size_t MESSAGE_SIZE = 232; ///< Longer messages are truncated
+        static constexpr size_t RING_SLOTS = 1024; ///< Records buffered per thread, a power of two
+
+        static Logger& instance() {
+            static Logger logger;
+            return logger;
+        }
+
+        ~Logger() {
+            running_ = false;
+            if (sink_.joinable()) {
+                sink_.join();
+            }
+            drain();
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            closeOwnedOutput();
+        }
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        bool enabled(LogLevel level) const {
+            return level >= level_.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Runtime threshold; cannot enable levels compiled out by OPENAI_LOG_LEVEL
+        void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+        LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+        /// @brief Write records to `output` (stderr by default); nullptr discards them
+        void setOutput(FILE* output) {
+            drain();
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            closeOwnedOutput();
+            output_ = output;
+        }
+
+        /// @brief Append records to the JSON-lines file at `path`
+        /// @return false if the file could not be opened; the current output is kept
+        bool openFile(const std::string& path) {
+            FILE* file = std::fopen(path.c_str(), "ab");
+            if (!file) {
+                return false;
+            }
+            drain();
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            closeOwnedOutput();
+            output_ = file;
+            ownsOutput_ = true;
+            return true;
+        }
+
+        /// @brief Format a record into the calling thread's ring; `event` must be a string literal
+        OPENAI_LOG_PRINTF(4, 5) void log(LogLevel level, const char* event, const char* format, ...) {
+            Ring& ring = threadRing();
+            size_t head = ring.head.load(std::memory_order_relaxed);
+            if (head - ring.tail.load(std::memory_order_acquire) >= RING_SLOTS) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            Record& record = ring.slots[head & (RING_SLOTS - 1)];
+            record.micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            record.level = level;
+            record.event = event;
+            va_list args;
+            va_start(args, format);
+            int length = std::vsnprintf(record.message, MESSAGE_SIZE, format, args);
+            va_end(args);
+            record.length = static_cast<uint16_t>(std::clamp(length, 0, static_cast<int>(MESSAGE_SIZE) - 1));
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        /// @brief Write out every record logged so far (any thread; waits for the output)
+        void flush() {
+            drain();
+        }
+
+        nlohmann::json toJson() const {
+            return nlohmann::json{
+                {"level", logLevelToString(level())},
+                {"compiled_level", logLevelToString(static_cast<LogLevel>(OPENAI_LOG_LEVEL))},
+                {"written", written_.load()},
+                {"dropped", dropped_.load()}
+            };
+        }
+
+    private:
+        struct Record {
+            int64_t micros; ///< Wall-clock time, microseconds since the epoch
+            const char* event; ///< Static event name
+            LogLevel level;
+            uint16_t length; ///< Bytes used in message
+            char message[MESSAGE_SIZE];
+        };
+
+        /// @brief Single-producer, single-consumer ring owned by one logging thread
+        struct Ring {
+            explicit Ring(size_t thread) : thread{ thread } {}
+
+            alignas(64) std::atomic<size_t> head{ 0 }; ///< Next slot to fill (logging thread)
+            alignas(64) std::atomic<size_t> tail{ 0 }; ///< Next slot to write out (drain)
+            std::atomic<bool> retired{ false }; ///< The owning thread has exited
+            size_t thread; ///< Small id printed instead of the OS thread id
+            std::array<Record, RING_SLOTS> slots;
+        };
+
+        /// @brief Keeps the calling thread's ring registered until the thread exits
+        struct RingOwner {
+            std::shared_ptr<Ring> ring;
+            ~RingOwner() {
+                if (ring) {
+                    ring->retired.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        Logger() {
+            sink_ = std::thread([this] { run(); });
+        }
+
+        Ring& threadRing() {
+            thread_local RingOwner owner;
+            if (!owner.ring) {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                owner.ring = std::make_shared<Ring>(rings_.size() + retiredRings_);
+                rings_.push_back(owner.ring);
+            }
+            return *owner.ring;
+        }
+
+        /// @brief Sink loop: write out the rings every few milliseconds
+        void run() {
+            while (running_.load(std::memory_order_relaxed)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                drain();
+            }
+        }
+
+        /// @brief Write the pending records of every ring, and forget rings of exited threads
+        void drain() {
+            std::vector<std::shared_ptr<Ring>> rings;
+            {
+                std::lock_guard<std::mutex> lock(ringsMutex_);
+                rings = rings_;
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            for (auto& ring : rings) {
+                bool retired = ring->retired.load(std::memory_order_acquire); // Read before the last records
+                size_t tail = ring->tail.load(std::memory_order_relaxed);
+                size_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) {
+                    writeRecord(ring->slots[tail & (RING_SLOTS - 1)], ring->thread);
+                }
+                ring->tail.store(tail, std::memory_order_release);
+
+                if (retired) {
+                    std::lock_guard<std::mutex> ringsLock(ringsMutex_);
+                    rings_.erase(std::remove(rings_.begin(), rings_.end(), ring), rings_.end());
+                    retiredRings_ += 1;
+                }
+            }
+            if (output_) {
+                std::fflush(output_);
+            }
+        }
+
+        void writeRecord(const Record& record, size_t thread) {
+            written_.fetch_add(1, std::memory_order_relaxed);
+            if (!output_) {
+                return;
+            }
+            nlohmann::json line{
+                {"ts_us", record.micros},
+                {"level", logLevelToString(record.level)},
+                {"thread", thread},
+                {"event", record.event},
+                {"msg", std::string(record.message, record.length)}
+            };
+            std::string text = line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            text += '\n';
+            std::fwrite(text.data(), 1, text.size(), output_);
+        }
+
+        void closeOwnedOutput() {
+            if (ownsOutput_ && output_) {
+                std::fclose(output_);
+            }
+            ownsOutput_ = false;
+        }
+
+        std::atomic<LogLevel> level_{ static_cast<LogLevel>(OPENAI_LOG_LEVEL) };
+        std::atomic<size_t> written_{ 0 };
+        std::atomic<size_t> dropped_{ 0 }; ///< Records lost to a full ring
+
+        std::mutex ringsMutex_; ///< Protects rings_ and retiredRings_
+        std::vector<std::shared_ptr<Ring>> rings_; ///< Rings of the threads that have logged
+        size_t retiredRings_{ 0 }; ///< Rings already removed, so thread ids stay unique
+
+        std::mutex outputMutex_; ///< Serializes drains and output changes
+        FILE* output_{ stderr };
+        bool ownsOutput_{ false };
+
+        std::atomic<bool> running_{ true };
+        std::thread sink_; ///< Runs run()
+    };
+
+} // namespace openai
+
+#define OPENAI_LOG_AT(level, event, ...) \
+    do { \
+        if (::openai::Logger::instance().enabled(level)) { \
+            ::openai::Logger::instance().log(level, event, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#if OPENAI_LOG_LEVEL <= OPENAI_LOG_LEVEL_TRACE
+#define OPENAI_LOG_TRACE(event, ...) OPENAI_LOG_AT(::openai::LogLevel::Trace, event, __VA_ARGS__)
+#else
+#define OPENAI_LOG_TRACE(event, ...) do {} while (0)
+#endif
+
+#if OPENAI_LOG_LEVEL <= OPENAI_LOG_LEVEL_DEBUG
+#define OPENAI_LOG_DEBUG(event, ...) OPENAI_LOG_AT(::openai::LogLevel::Debug, event, __VA_ARGS__)
+#else
+#define OPENAI_LOG_DEBUG(event, ...) do {} while (0)
+#endif
+
+#if OPENAI_LOG_LEVEL <= OPENAI_LOG_LEVEL_INFO
+#define OPENAI_LOG_INFO(event, ...) OPENAI_LOG_AT(::openai::LogLevel::Info, event, __VA_ARGS__)
+#else
+#define OPENAI_LOG_INFO(event, ...) do {} while (0)
+#endif
+
+#if OPENAI_LOG_LEVEL <= OPENAI_LOG_LEVEL_WARN
+#define OPENAI_LOG_WARN(event, ...) OPENAI_LOG_AT(::openai::LogLevel::Warn, event, __VA_ARGS__)
+#else
+#define OPENAI_LOG_WARN(event, ...) do {} while (0)
+#endif
+
+#if OPENAI_LOG_LEVEL <= OPENAI_LOG_LEVEL_ERROR
+#define OPENAI_LOG_ERROR(event, ...) OPENAI_LOG_AT(::openai::LogLevel::Error, event, __VA_ARGS__)
+#else
+#define OPENAI_LOG_ERROR(event, ...) do {} while (0)
+#endif
+
+#endif // LOGGER_HPP_
@@ -0,0 +1,89 @@
+#ifndef LOGGING_BENCHMARK_HPP_
+#define LOGGING_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "logger.hpp"
+
+namespace openai {
+
+    namespace detail {
+
+        /// @brief Stand-in for a curl write callback: queue the chunk, optionally log it
+        template <bool Log>
+        size_t benchmarkCallback(const char* data, size_t size, std::vector<char>& queue) {
+            if (Log) {
+                OPENAI_LOG_AT(LogLevel::Trace, "audio_received", "%zu bytes", size);
+            }
+            queue.insert(queue.end(), data, data + size);
+            return size;
+        }
+
+        /// @brief Median time per callback in nanoseconds over `batches` batches
+        template <bool Log>
+        double timeCallbacks(size_t batches, size_t batchSize, size_t chunkSize) {
+            std::vector<char> chunk(chunkSize, 'x');
+            std::vector<char> queue;
+            queue.reserve(chunkSize * batchSize);
+            std::vector<double> perCall;
+            perCall.reserve(batches);
+            for (size_t batch = 0; batch < batches; ++batch) {
+                queue.clear();
+                auto begin = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < batchSize; ++i) {
+                    benchmarkCallback<Log>(chunk.data(), chunk.size(), queue);
+                }
+                auto elapsed = std::chrono::steady_clock::now() - begin;
+                perCall.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / batchSize);
+                Logger::instance().flush(); // Keep the ring from filling; not timed
+            }
+            std::nth_element(perCall.begin(), perCall.begin() + perCall.size() / 2, perCall.end());
+            return perCall[perCall.size() / 2];
+        }
+
+    } // namespace detail
+
+    /**
+    * @brief Compare the cost of a network callback without logging, with logging disabled at run time
+    * and with logging enabled
+    *
+    * "compiled_out" has no logging statement at all, which is what every OPENAI_LOG_* macro below
+    * OPENAI_LOG_LEVEL expands to. Enabled records are formatted into the ring and discarded by the sink,
+    * so the numbers cover the hot-path cost only, not the sink's I/O.
+    */
+    inline int logging_benchmark_main(size_t chunkSize = 4096) {
+        const size_t batches = 200;
+        const size_t batchSize = Logger::RING_SLOTS / 2;
+        Logger& logger = Logger::instance();
+        LogLevel previousLevel = logger.level();
+        logger.setOutput(nullptr);
+
+        double compiledOut = detail::timeCallbacks<false>(batches, batchSize, chunkSize);
+        logger.setLevel(LogLevel::Off);
+        double disabled = detail::timeCallbacks<true>(batches, batchSize, chunkSize);
+        logger.setLevel(LogLevel::Trace);
+        double enabled = detail::timeCallbacks<true>(batches, batchSize, chunkSize);
+
+        logger.setLevel(previousLevel);
+        logger.setOutput(stderr);
+
+        nlohmann::json result{
+            {"chunk_bytes", chunkSize},
+            {"callbacks", batches * batchSize},
+            {"compiled_out_ns", compiledOut},
+            {"disabled_ns", disabled},
+            {"enabled_ns", enabled},
+            {"logger", logger.toJson()}
+        };
+        std::cout << "Logging benchmark: " << result.dump(2) << std::endl;
+        return 0;
+    }
+
+} // namespace openai
+
+#endif // LOGGING_BENCHMARK_HPP_
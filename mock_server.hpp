@@ -0,0 +1,872 @@
+#ifndef MOCK_SERVER_HPP_
+#define MOCK_SERVER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "logger.hpp"
+
+namespace openai {
+
+    /**
+    * @brief Local stand-in for the OpenAI and AssemblyAI HTTP APIs
+    *
+    * Serves plain HTTP/1.1 with keep-alive on 127.0.0.1 so Session, the RequestEngine and the
+    * ConnectionPool can be exercised and benchmarked without a network:
+    * - POST .../audio/speech replays a recorded Opus, MP3 or FLAC file, or a synthesized tone for WAV
+    *   and PCM, picked by `response_format`
+    * - POST .../chat/completions streams a reply as server-sent events, one word per event
+    * - POST .../realtime/token issues a numbered AssemblyAI token after `tokenDelay`, rejecting an
+    *   `expires_in` outside the API's 60 to 360000 seconds
+    * - GET /v2/realtime/ws upgrades to a websocket that plays the AssemblyAI realtime protocol: it
+    *   answers every audio frame with a PartialTranscript revealing `transcript` one word per
+    *   `transcriptWordMs` of audio received, and closes each utterance with a FinalTranscript
+    *
+    * First-byte delay, write chunk size, a bandwidth cap, periodic error responses and connections
+    * dropped mid-body can be injected. Faults are applied every Nth request rather than at random, so
+    * runs are reproducible.
+    */
+    class MockServer {
+    public:
+        struct Options {
+            unsigned short port{ 0 }; ///< Port to listen on, 0 for any free port
+            std::string opusFile{ "sine.opus" }; ///< Replayed for response_format "opus" (response.opus holds MP3 data)
+            std::string mp3File{ "response.mp3" }; ///< Replayed for response_format "mp3"
+            std::string flacFile; ///< Replayed for response_format "flac"; empty answers it with 400
+            double toneSeconds{ 2.0 }; ///< Length of the 440 Hz tone served for "wav" and "pcm"
+            std::string chatReply{ "C plus plus is the best language in the world. It is fast, and it is everywhere." }; ///< Streamed for chat completions
+            std::chrono::milliseconds firstByteDelay{ 0 }; ///< Delay before the response headers are sent
+            std::chrono::milliseconds tokenInterval{ 20 }; ///< Delay between streamed chat events
+            size_t chunkSize{ 4096 }; ///< Largest single socket write of a response body
+            size_t bytesPerSecond{ 0 }; ///< Bandwidth cap per response, 0 for none
+            size_t errorEvery{ 0 }; ///< Answer every Nth request with `errorStatus`, 0 for never
+            int errorStatus{ 500 }; ///< Status of injected errors
+            size_t dropEvery{ 0 }; ///< Close the connection halfway through every Nth response body, 0 for never
+            std::string transcript{ "i have control" }; ///< Text of every utterance of a realtime session
+            std::chrono::milliseconds transcriptWordMs{ 300 }; ///< Audio per transcribed word of a realtime session
+            std::chrono::milliseconds tokenDelay{ 0 }; ///< Extra delay before answering a realtime token request
+        };
+
+        struct Stats {
+            size_t connections; ///< Accepted connections
+            size_t requests; ///< Requests received
+            size_t bytesSent; ///< Response bytes written, headers included
+            size_t injectedErrors; ///< Requests answered with an injected error
+            size_t droppedConnections; ///< Responses cut off by an injected disconnect
+            size_t realtimeSessions; ///< Websocket sessions opened on the realtime endpoint
+            size_t realtimeAudioBytes; ///< Audio received over those sessions
+            size_t tokensIssued; ///< Realtime tokens handed out
+        };
+
+        MockServer() : MockServer(Options{}) {}
+        explicit MockServer(Options options) : options_{ std::move(options) } {}
+
+        ~MockServer() {
+            stop();
+        }
+
+        MockServer(const MockServer&) = delete;
+        MockServer& operator=(const MockServer&) = delete;
+
+        /// @brief Load the recorded responses and start listening
+        /// @return false if a recording could not be read or the port could not be bound
+        bool start() {
+            if (!loadFile(options_.opusFile, opus_) || !loadFile(options_.mp3File, mp3_)
+                || (!options_.flacFile.empty() && !loadFile(options_.flacFile, flac_))) {
+                return false;
+            }
+            pcm_ = synthesizeTone(options_.toneSeconds);
+            wav_ = wavHeader(static_cast<uint32_t>(pcm_.size())) + pcm_;
+
+#ifdef _WIN32
+            WSADATA wsaData;
+            if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+                OPENAI_LOG_ERROR("mock_server_failed", "WSAStartup failed");
+                return false;
+            }
+#endif
+            listener_ = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener_ == INVALID_SOCK) {
+                OPENAI_LOG_ERROR("mock_server_failed", "Could not create socket");
+                return false;
+            }
+            int reuse = 1;
+            setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(options_.port);
+            if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener_, 64) != 0) {
+                OPENAI_LOG_ERROR("mock_server_failed", "Could not listen on port %d", static_cast<int>(options_.port));
+                closeSocket(listener_);
+                listener_ = INVALID_SOCK;
+                return false;
+            }
+            socklen_t length = sizeof(address);
+            getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+            port_ = ntohs(address.sin_port);
+
+            running_ = true;
+            acceptThread_ = std::thread([this] { acceptLoop(); });
+            return true;
+        }
+
+        /// @brief Stop listening and close every open connection
+        void stop() {
+            if (!running_.exchange(false)) {
+                return;
+            }
+            shutdown(listener_, SHUT_BOTH);
+            closeSocket(listener_);
+            if (acceptThread_.joinable()) {
+                acceptThread_.join();
+            }
+
+            std::vector<std::thread> threads;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (Socket client : clients_) {
+                    shutdown(client, SHUT_BOTH);
+                }
+                threads.swap(threads_);
+                finished_.clear();
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            listener_ = INVALID_SOCK;
+#ifdef _WIN32
+            WSACleanup();
+#endif
+        }
+
+        unsigned short port() const { return port_; }
+
+        /// @brief Base URL to pass to OpenAI::setBaseUrl()
+        std::string openaiBaseUrl() const { return "http://127.0.0.1:" + std::to_string(port_) + "/v1/"; }
+
+        /// @brief Base URL to pass to assemblyai::setApiBaseUrl()
+        std::string assemblyaiBaseUrl() const { return "http://127.0.0.1:" + std::to_string(port_); }
+
+        Stats stats() const {
+            return Stats{ connections_.load(), requests_.load(), bytesSent_.load(), injectedErrors_.load(), droppedConnections_.load(),
+                realtimeSessions_.load(), realtimeAudioBytes_.load(), tokensIssued_.load() };
+        }
+
+        nlohmann::json toJson() const {
+            Stats s = stats();
+            return nlohmann::json{
+                {"port", port_},
+                {"connections", s.connections},
+                {"requests", s.requests},
+                {"requests_per_connection", s.connections > 0 ? static_cast<double>(s.requests) / s.connections : 0.0},
+                {"bytes_sent", s.bytesSent},
+                {"injected_errors", s.injectedErrors},
+                {"dropped_connections", s.droppedConnections},
+                {"realtime_sessions", s.realtimeSessions},
+                {"realtime_audio_bytes", s.realtimeAudioBytes},
+                {"tokens_issued", s.tokensIssued}
+            };
+        }
+
+    private:
+#ifdef _WIN32
+        using Socket = SOCKET;
+        static constexpr Socket INVALID_SOCK = INVALID_SOCKET;
+        static constexpr int SHUT_BOTH = SD_BOTH;
+        static constexpr int SEND_FLAGS = 0;
+        static void closeSocket(Socket s) { closesocket(s); }
+#else
+        using Socket = int;
+        static constexpr Socket INVALID_SOCK = -1;
+        static constexpr int SHUT_BOTH = SHUT_RDWR;
+#ifdef MSG_NOSIGNAL
+        static constexpr int SEND_FLAGS = MSG_NOSIGNAL; // A client hanging up mid-response must not raise SIGPIPE
+#else
+        static constexpr int SEND_FLAGS = 0; // macOS: SO_NOSIGPIPE is set on every accepted socket instead
+#endif
+        static void closeSocket(Socket s) { close(s); }
+#endif
+
+        static constexpr size_t MAX_BODY_BYTES = 16 * 1024 * 1024; ///< Larger requests are answered with 400
+
+        struct HttpRequest {
+            std::string method;
+            std::string path;
+            std::string body;
+            bool keepAlive{ true };
+            bool malformed{ false }; ///< The headers could not be parsed; answered with 400 and the connection closed
+            std::string webSocketKey; ///< Sec-WebSocket-Key of an upgrade request, empty otherwise
+        };
+
+        /// @brief A response to write; `events` are sent as separate chunks `tokenInterval` apart
+        struct HttpResponse {
+            int status{ 200 };
+            std::string contentType;
+            std::string body;
+            std::vector<std::string> events;
+        };
+
+        static bool loadFile(const std::string& path, std::string& contents) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                OPENAI_LOG_ERROR("mock_server_failed", "Could not read %s", path.c_str());
+                return false;
+            }
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            return true;
+        }
+
+        /// @brief 16-bit little-endian mono tone at 24 kHz, the layout the API uses for "pcm"
+        static std::string synthesizeTone(double seconds) {
+            const double pi = 3.14159265358979323846;
+            size_t samples = static_cast<size_t>(seconds * TONE_SAMPLE_RATE);
+            std::string pcm(samples * 2, '\0');
+            for (size_t i = 0; i < samples; ++i) {
+                int16_t value = static_cast<int16_t>(8000 * std::sin(2 * pi * 440 * i / TONE_SAMPLE_RATE));
+                pcm[2 * i] = static_cast<char>(value & 0xFF);
+                pcm[2 * i + 1] = static_cast<char>((value >> 8) & 0xFF);
+            }
+            return pcm;
+        }
+
+        /// @brief RIFF header of a 16-bit mono WAV file at TONE_SAMPLE_RATE holding `dataBytes` of samples
+        static std::string wavHeader(uint32_t dataBytes) {
+            std::string header;
+            auto put = [&header](uint32_t value, int bytes) {
+                for (int i = 0; i < bytes; ++i) {
+                    header += static_cast<char>((value >> (8 * i)) & 0xFF);
+                }
+            };
+            header += "RIFF";
+            put(36 + dataBytes, 4);
+            header += "WAVEfmt ";
+            put(16, 4);
+            put(1, 2); // PCM
+            put(1, 2); // Mono
+            put(TONE_SAMPLE_RATE, 4);
+            put(TONE_SAMPLE_RATE * 2, 4);
+            put(2, 2);
+            put(16, 2);
+            header += "data";
+            put(dataBytes, 4);
+            return header;
+        }
+
+        void acceptLoop() {
+            while (running_) {
+                Socket client = accept(listener_, nullptr, nullptr);
+                if (client == INVALID_SOCK) {
+                    continue; // Woken up by stop(), or a transient failure
+                }
+                int noDelay = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#ifdef SO_NOSIGPIPE
+                int noSigPipe = 1;
+                setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+                connections_ += 1;
+                reapFinishedThreads();
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!running_) {
+                    closeSocket(client);
+                    break;
+                }
+                clients_.push_back(client);
+                threads_.emplace_back([this, client] { serveConnection(client); });
+            }
+        }
+
+        /// @brief Join the threads of connections that have closed, so they do not pile up until stop()
+        void reapFinishedThreads() {
+            std::vector<std::thread> finished;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (std::thread::id id : finished_) {
+                    auto it = std::find_if(threads_.begin(), threads_.end(), [id](const std::thread& thread) { return thread.get_id() == id; });
+                    if (it != threads_.end()) {
+                        finished.push_back(std::move(*it));
+                        threads_.erase(it);
+                    }
+                }
+                finished_.clear();
+            }
+            for (auto& thread : finished) {
+                thread.join(); // Already past serveConnection(), so this returns at once
+            }
+        }
+
+        /// @brief Answer requests on one keep-alive connection until either side closes it
+        void serveConnection(Socket client) {
+            std::string pending;
+            HttpRequest request;
+            while (running_ && readRequest(client, pending, request)) {
+                size_t number = requests_.fetch_add(1) + 1;
+                if (request.malformed) {
+                    writeResponse(client, HttpResponse{ 400, "application/json", R"({"error":{"message":"Malformed request"}})", {} }, false);
+                    break;
+                }
+                if (!request.webSocketKey.empty() && request.path.rfind("/v2/realtime/ws", 0) == 0) {
+                    serveRealtimeSession(client, request, pending);
+                    break;
+                }
+                HttpResponse response = route(request);
+                bool drop = false;
+                if (options_.errorEvery > 0 && number % options_.errorEvery == 0) {
+                    injectedErrors_ += 1;
+                    response = HttpResponse{ options_.errorStatus, "application/json",
+                        R"({"error":{"message":"Injected error from the mock server","type":"server_error"}})", {} };
+                }
+                else if (options_.dropEvery > 0 && number % options_.dropEvery == 0) {
+                    drop = true;
+                }
+                if (!writeResponse(client, response, drop) || !request.keepAlive) {
+                    break;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+            }
+            closeSocket(client);
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_.push_back(std::this_thread::get_id());
+        }
+
+        /// @brief Read one request; bytes past its end are kept in `pending` for the next one
+        bool readRequest(Socket client, std::string& pending, HttpRequest& request) {
+            size_t headerEnd;
+            while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+                if (!receive(client, pending)) {
+                    return false;
+                }
+            }
+
+            std::string head = pending.substr(0, headerEnd);
+            size_t lineEnd = head.find("\r\n");
+            std::string requestLine = head.substr(0, lineEnd);
+            size_t space = requestLine.find(' ');
+            size_t secondSpace = requestLine.find(' ', space + 1);
+            if (space == std::string::npos || secondSpace == std::string::npos) {
+                return false;
+            }
+            request.method = requestLine.substr(0, space);
+            request.path = requestLine.substr(space + 1, secondSpace - space - 1);
+            request.keepAlive = requestLine.compare(secondSpace + 1, std::string::npos, "HTTP/1.0") != 0;
+            request.webSocketKey.clear();
+            request.malformed = false;
+
+            size_t contentLength = 0;
+            size_t position = lineEnd;
+            while (position != std::string::npos && position < head.size()) {
+                size_t next = head.find("\r\n", position + 2);
+                std::string line = head.substr(position + 2, next == std::string::npos ? std::string::npos : next - position - 2);
+                std::string name = line.substr(0, line.find(':'));
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                std::string value = line.find(':') == std::string::npos ? "" : line.substr(line.find(':') + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if (name == "content-length") {
+                    unsigned long long length = 0;
+                    auto parsed = std::from_chars(value.data(), value.data() + value.size(), length);
+                    if (parsed.ec != std::errc{} || parsed.ptr != value.data() + value.size() || length > MAX_BODY_BYTES) {
+                        // The body cannot be delimited, so answer and close the connection without reading it
+                        request.malformed = true;
+                        request.keepAlive = false;
+                        pending.clear();
+                        return true;
+                    }
+                    contentLength = static_cast<size_t>(length);
+                }
+                else if (name == "connection") {
+                    request.keepAlive = value != "close";
+                }
+                else if (name == "sec-websocket-key") {
+                    request.webSocketKey = value;
+                }
+                position = next;
+            }
+
+            size_t bodyStart = headerEnd + 4;
+            while (pending.size() < bodyStart + contentLength) {
+                if (!receive(client, pending)) {
+                    return false;
+                }
+            }
+            request.body = pending.substr(bodyStart, contentLength);
+            pending.erase(0, bodyStart + contentLength);
+            return true;
+        }
+
+        static bool receive(Socket client, std::string& pending) {
+            char buffer[4096];
+            int received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                return false;
+            }
+            pending.append(buffer, received);
+            return true;
+        }
+
+        HttpResponse route(const HttpRequest& request) {
+            if (request.method != "POST") {
+                return HttpResponse{ 405, "application/json", R"({"error":{"message":"Only POST is supported"}})", {} };
+            }
+
+            if (endsWith(request.path, "/audio/speech")) {
+                nlohmann::json body = nlohmann::json::parse(request.body, nullptr, false);
+                std::string format = body.is_object() ? body.value("response_format", "mp3") : "mp3";
+                if (format == "opus") {
+                    return HttpResponse{ 200, "audio/ogg", opus_, {} };
+                }
+                if (format == "mp3") {
+                    return HttpResponse{ 200, "audio/mpeg", mp3_, {} };
+                }
+                if (format == "flac" && !flac_.empty()) {
+                    return HttpResponse{ 200, "audio/flac", flac_, {} };
+                }
+                if (format == "wav") {
+                    return HttpResponse{ 200, "audio/wav", wav_, {} };
+                }
+                if (format == "pcm") {
+                    return HttpResponse{ 200, "audio/pcm", pcm_, {} };
+                }
+                nlohmann::json error = { {"error", {{"message", "The mock server has no recording for response_format " + format}}} };
+                return HttpResponse{ 400, "application/json", error.dump(), {} };
+            }
+
+            if (endsWith(request.path, "/chat/completions")) {
+                HttpResponse response{ 200, "text/event-stream", "", {} };
+                size_t begin = 0;
+                while (begin < options_.chatReply.size()) {
+                    // One word per event, keeping the space in front of it as the API does
+                    size_t end = options_.chatReply.find(' ', begin + 1);
+                    std::string token = options_.chatReply.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+                    nlohmann::json delta = { {"choices", {{ {"index", 0}, {"delta", {{"content", token}}}, {"finish_reason", nullptr} }}} };
+                    response.events.push_back("data: " + delta.dump() + "\n\n");
+                    begin = end == std::string::npos ? options_.chatReply.size() : end;
+                }
+                nlohmann::json finish = { {"choices", {{ {"index", 0}, {"delta", nlohmann::json::object()}, {"finish_reason", "stop"} }}} };
+                response.events.push_back("data: " + finish.dump() + "\n\n");
+                response.events.push_back("data: [DONE]\n\n");
+                return response;
+            }
+
+            if (endsWith(request.path, "/realtime/token")) {
+                nlohmann::json body = nlohmann::json::parse(request.body, nullptr, false);
+                int expiresIn = body.is_object() && body.contains("expires_in") && body["expires_in"].is_number_integer()
+                    ? body["expires_in"].get<int>() : 0;
+                if (expiresIn < 60 || expiresIn > 360000) {
+                    return HttpResponse{ 400, "application/json", R"({"error":"expires_in must be between 60 and 360000"})", {} };
+                }
+                std::this_thread::sleep_for(options_.tokenDelay);
+                nlohmann::json token = { {"token", "mock-realtime-token-" + std::to_string(tokensIssued_.fetch_add(1) + 1)} };
+                return HttpResponse{ 200, "application/json", token.dump(), {} };
+            }
+
+            return HttpResponse{ 404, "application/json", R"({"error":{"message":"Unknown endpoint"}})", {} };
+        }
+
+        /// @brief Write the response with the configured delay, chunking and bandwidth cap
+        /// @return false if the connection must be closed
+        bool writeResponse(Socket client, const HttpResponse& response, bool drop) {
+            std::this_thread::sleep_for(options_.firstByteDelay);
+
+            bool chunked = !response.events.empty();
+            std::string head = "HTTP/1.1 " + std::to_string(response.status) + (response.status < 400 ? " OK" : " Error") + "\r\n"
+                "Content-Type: " + response.contentType + "\r\n";
+            head += chunked ? "Transfer-Encoding: chunked\r\n" : "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+            head += "\r\n";
+
+            Pacer pacer{ options_.bytesPerSecond };
+            if (!sendAll(client, head.data(), head.size(), pacer)) {
+                return false;
+            }
+
+            if (!chunked) {
+                size_t limit = drop ? response.body.size() / 2 : response.body.size();
+                if (!sendAll(client, response.body.data(), limit, pacer)) {
+                    return false;
+                }
+                if (drop) {
+                    droppedConnections_ += 1;
+                    return false;
+                }
+                return true;
+            }
+
+            for (size_t i = 0; i < response.events.size(); ++i) {
+                if (i > 0) {
+                    std::this_thread::sleep_for(options_.tokenInterval);
+                }
+                if (drop && i == response.events.size() / 2) {
+                    droppedConnections_ += 1;
+                    return false;
+                }
+                const std::string& event = response.events[i];
+                char size[32];
+                std::snprintf(size, sizeof(size), "%zx\r\n", event.size());
+                std::string chunk = size + event + "\r\n";
+                if (!sendAll(client, chunk.data(), chunk.size(), pacer)) {
+                    return false;
+                }
+            }
+            return sendAll(client, "0\r\n\r\n", 5, pacer);
+        }
+
+        /// @brief Play one AssemblyAI realtime session on an upgraded connection
+        void serveRealtimeSession(Socket client, const HttpRequest& request, std::string& pending) {
+            Pacer pacer{ 0 };
+            std::string token = queryParameter(request.path, "token");
+            if (token.empty()) {
+                std::string response = "HTTP/1.1 401 Unauthorized\r\nContent-Length: 0\r\n\r\n";
+                sendAll(client, response.data(), response.size(), pacer);
+                return;
+            }
+            std::string rate = queryParameter(request.path, "sample_rate");
+            double sampleRate = rate.empty() ? 16000.0 : std::stod(rate);
+
+            std::string handshake = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: " + webSocketAccept(request.webSocketKey) + "\r\n\r\n";
+            if (!sendAll(client, handshake.data(), handshake.size(), pacer)) {
+                return;
+            }
+            size_t session = realtimeSessions_.fetch_add(1) + 1;
+            nlohmann::json begins = { {"message_type", "SessionBegins"}, {"session_id", "mock-session-" + std::to_string(session)},
+                {"expires_at", "2099-01-01T00:00:00.000000"} };
+            if (!sendFrame(client, WS_TEXT, begins.dump())) {
+                return;
+            }
+
+            std::vector<std::string> words;
+            for (size_t begin = 0, end; begin < options_.transcript.size(); begin = end + 1) {
+                end = options_.transcript.find(' ', begin);
+                end = end == std::string::npos ? options_.transcript.size() : end;
+                if (end > begin) {
+                    words.push_back(options_.transcript.substr(begin, end - begin));
+                }
+            }
+            const long long wordMs = std::max<long long>(options_.transcriptWordMs.count(), 1);
+            size_t audioBytes = 0;
+            long long utteranceStart = 0; // Stream time (ms) of the current utterance
+            auto transcript = [&](long long audioEnd, bool final) {
+                size_t count = std::min(words.size(), static_cast<size_t>((audioEnd - utteranceStart + wordMs - 1) / wordMs));
+                std::string text;
+                for (size_t i = 0; i < count; ++i) {
+                    text += (i > 0 ? " " : "") + words[i];
+                }
+                nlohmann::json message = { {"message_type", final ? "FinalTranscript" : "PartialTranscript"},
+                    {"audio_start", utteranceStart}, {"audio_end", audioEnd}, {"confidence", 0.9}, {"text", text},
+                    {"words", nlohmann::json::array()}, {"created", "2099-01-01T00:00:00.000000"} };
+                if (final) {
+                    message["punctuated"] = false;
+                    message["text_formatted"] = false;
+                    utteranceStart = audioEnd;
+                }
+                return sendFrame(client, WS_TEXT, message.dump());
+            };
+
+            int opcode = 0;
+            std::string payload;
+            while (running_ && readFrame(client, pending, opcode, payload)) {
+                long long audioEnd = static_cast<long long>(audioBytes / 2 * 1000 / sampleRate);
+                if (opcode == WS_BINARY) {
+                    audioBytes += payload.size();
+                    realtimeAudioBytes_ += payload.size();
+                    audioEnd = static_cast<long long>(audioBytes / 2 * 1000 / sampleRate);
+                    bool final = audioEnd - utteranceStart >= wordMs * static_cast<long long>(words.size());
+                    if (!transcript(audioEnd, final)) {
+                        return;
+                    }
+                }
+                else if (opcode == WS_TEXT) {
+                    nlohmann::json message = nlohmann::json::parse(payload, nullptr, false);
+                    if (!message.is_object()) {
+                        sendFrame(client, WS_TEXT, R"({"error":"Invalid JSON"})");
+                    }
+                    else if (message.value("force_end_utterance", false) && audioEnd > utteranceStart) {
+                        transcript(audioEnd, true);
+                    }
+                    else if (message.value("terminate_session", false)) {
+                        if (audioEnd > utteranceStart) {
+                            transcript(audioEnd, true);
+                        }
+                        sendFrame(client, WS_TEXT, R"({"message_type":"SessionTerminated"})");
+                        sendFrame(client, WS_CLOSE, std::string("\x03\xE8", 2)); // 1000: normal closure
+                        return;
+                    }
+                }
+                else if (opcode == WS_PING) {
+                    sendFrame(client, WS_PONG, payload);
+                }
+                else if (opcode == WS_CLOSE) {
+                    sendFrame(client, WS_CLOSE, payload);
+                    return;
+                }
+            }
+        }
+
+        /// @brief Read one (possibly fragmented) client message, unmasking it
+        bool readFrame(Socket client, std::string& pending, int& opcode, std::string& payload) {
+            payload.clear();
+            opcode = 0;
+            while (true) {
+                while (pending.size() < 2) {
+                    if (!receive(client, pending)) {
+                        return false;
+                    }
+                }
+                const auto byte = [&pending](size_t i) { return static_cast<unsigned char>(pending[i]); };
+                bool fin = (byte(0) & 0x80) != 0;
+                int frameOpcode = byte(0) & 0x0F;
+                bool masked = (byte(1) & 0x80) != 0;
+                uint64_t length = byte(1) & 0x7F;
+                size_t header = 2;
+                if (length >= 126) {
+                    size_t extra = length == 126 ? 2 : 8;
+                    while (pending.size() < header + extra) {
+                        if (!receive(client, pending)) {
+                            return false;
+                        }
+                    }
+                    length = 0;
+                    for (size_t i = 0; i < extra; ++i) {
+                        length = (length << 8) | byte(header + i);
+                    }
+                    header += extra;
+                }
+                size_t maskOffset = header;
+                header += masked ? 4 : 0;
+                while (pending.size() < header + length) {
+                    if (!receive(client, pending)) {
+                        return false;
+                    }
+                }
+
+                size_t start = payload.size();
+                payload.append(pending, header, static_cast<size_t>(length));
+                if (masked) {
+                    for (size_t i = 0; i < length; ++i) {
+                        payload[start + i] = static_cast<char>(payload[start + i] ^ pending[maskOffset + i % 4]);
+                    }
+                }
+                pending.erase(0, header + static_cast<size_t>(length));
+
+                if (frameOpcode >= WS_CLOSE) {
+                    opcode = frameOpcode; // Control frames are never fragmented
+                    return true;
+                }
+                if (frameOpcode != 0) {
+                    opcode = frameOpcode;
+                }
+                if (fin) {
+                    return true;
+                }
+            }
+        }
+
+        /// @brief Send one unmasked, unfragmented frame
+        bool sendFrame(Socket client, int opcode, const std::string& payload) {
+            std::string frame(1, static_cast<char>(0x80 | opcode));
+            if (payload.size() < 126) {
+                frame += static_cast<char>(payload.size());
+            }
+            else if (payload.size() <= 0xFFFF) {
+                frame += static_cast<char>(126);
+                frame += static_cast<char>((payload.size() >> 8) & 0xFF);
+                frame += static_cast<char>(payload.size() & 0xFF);
+            }
+            else {
+                frame += static_cast<char>(127);
+                for (int shift = 56; shift >= 0; shift -= 8) {
+                    frame += static_cast<char>((static_cast<uint64_t>(payload.size()) >> shift) & 0xFF);
+                }
+            }
+            frame += payload;
+            Pacer pacer{ 0 };
+            return sendAll(client, frame.data(), frame.size(), pacer);
+        }
+
+        static std::string queryParameter(const std::string& path, const std::string& name) {
+            size_t query = path.find('?');
+            if (query == std::string::npos) {
+                return "";
+            }
+            for (size_t begin = query + 1, end; begin < path.size(); begin = end + 1) {
+                end = path.find('&', begin);
+                end = end == std::string::npos ? path.size() : end;
+                if (path.compare(begin, name.size() + 1, name + "=") == 0) {
+                    return path.substr(begin + name.size() + 1, end - begin - name.size() - 1);
+                }
+            }
+            return "";
+        }
+
+        /// @brief Sec-WebSocket-Accept for a client key (RFC 6455, section 4.2.2)
+        static std::string webSocketAccept(const std::string& key) {
+            std::string digest = sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+            static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string encoded;
+            for (size_t i = 0; i < digest.size(); i += 3) {
+                uint32_t group = static_cast<unsigned char>(digest[i]) << 16;
+                group |= i + 1 < digest.size() ? static_cast<unsigned char>(digest[i + 1]) << 8 : 0;
+                group |= i + 2 < digest.size() ? static_cast<unsigned char>(digest[i + 2]) : 0;
+                encoded += alphabet[(group >> 18) & 0x3F];
+                encoded += alphabet[(group >> 12) & 0x3F];
+                encoded += i + 1 < digest.size() ? alphabet[(group >> 6) & 0x3F] : '=';
+                encoded += i + 2 < digest.size() ? alphabet[group & 0x3F] : '=';
+            }
+            return encoded;
+        }
+
+        /// @brief SHA-1 of `message` as 20 raw bytes; only used for the websocket handshake
+        static std::string sha1(const std::string& message) {
+            uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+            std::string data = message;
+            uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+            data += static_cast<char>(0x80);
+            while (data.size() % 64 != 56) {
+                data += '\0';
+            }
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                data += static_cast<char>((bits >> shift) & 0xFF);
+            }
+            auto rotate = [](uint32_t value, int count) { return (value << count) | (value >> (32 - count)); };
+            for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+                uint32_t w[80];
+                for (int i = 0; i < 16; ++i) {
+                    w[i] = static_cast<uint32_t>(static_cast<unsigned char>(data[chunk + 4 * i])) << 24
+                        | static_cast<uint32_t>(static_cast<unsigned char>(data[chunk + 4 * i + 1])) << 16
+                        | static_cast<uint32_t>(static_cast<unsigned char>(data[chunk + 4 * i + 2])) << 8
+                        | static_cast<uint32_t>(static_cast<unsigned char>(data[chunk + 4 * i + 3]));
+                }
+                for (int i = 16; i < 80; ++i) {
+                    w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+                }
+                uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for (int i = 0; i < 80; ++i) {
+                    uint32_t f, k;
+                    if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+                    else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+                    else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+                    else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+                    uint32_t temp = rotate(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotate(b, 30);
+                    b = a;
+                    a = temp;
+                }
+                h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+            }
+            std::string digest;
+            for (uint32_t value : h) {
+                for (int shift = 24; shift >= 0; shift -= 8) {
+                    digest += static_cast<char>((value >> shift) & 0xFF);
+                }
+            }
+            return digest;
+        }
+
+        /// @brief Spaces writes so a response never goes faster than the bandwidth cap
+        struct Pacer {
+            size_t bytesPerSecond;
+            std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+            size_t sent{ 0 };
+
+            void wait(size_t bytes) {
+                sent += bytes;
+                if (bytesPerSecond > 0) {
+                    std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(static_cast<double>(sent) / bytesPerSecond)));
+                }
+            }
+        };
+
+        bool sendAll(Socket client, const char* data, size_t size, Pacer& pacer) {
+            size_t offset = 0;
+            while (offset < size) {
+                size_t piece = std::min(std::max<size_t>(options_.chunkSize, 1), size - offset);
+                pacer.wait(piece);
+                int written = send(client, data + offset, static_cast<int>(piece), SEND_FLAGS);
+                if (written <= 0) {
+                    return false;
+                }
+                offset += written;
+                bytesSent_ += written;
+            }
+            return true;
+        }
+
+        static bool endsWith(const std::string& text, const std::string& suffix) {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        Options options_;
+        std::string opus_; ///< Recorded Ogg Opus response
+        std::string mp3_; ///< Recorded MP3 response
+        std::string flac_; ///< Recorded FLAC response, empty if none
+        std::string wav_; ///< Synthesized tone with a WAV header
+        std::string pcm_; ///< Synthesized tone as raw samples
+
+        static constexpr uint32_t TONE_SAMPLE_RATE = 24000;
+        static constexpr int WS_TEXT = 0x1;
+        static constexpr int WS_BINARY = 0x2;
+        static constexpr int WS_CLOSE = 0x8;
+        static constexpr int WS_PING = 0x9;
+        static constexpr int WS_PONG = 0xA;
+
+        Socket listener_{ INVALID_SOCK };
+        unsigned short port_{ 0 };
+        std::atomic<bool> running_{ false };
+        std::thread acceptThread_;
+
+        std::mutex mutex_; ///< Protects clients_, threads_ and finished_
+        std::vector<Socket> clients_; ///< Open connections, shut down by stop()
+        std::vector<std::thread> threads_; ///< One thread per open connection, and closed ones not yet reaped
+        std::vector<std::thread::id> finished_; ///< Threads done with their connection, joined by the accept loop
+
+        std::atomic<size_t> connections_{ 0 };
+        std::atomic<size_t> requests_{ 0 };
+        std::atomic<size_t> bytesSent_{ 0 };
+        std::atomic<size_t> injectedErrors_{ 0 };
+        std::atomic<size_t> droppedConnections_{ 0 };
+        std::atomic<size_t> realtimeSessions_{ 0 };
+        std::atomic<size_t> realtimeAudioBytes_{ 0 };
+        std::atomic<size_t> tokensIssued_{ 0 };
+    };
+
+} // namespace openai
+
+#endif // MOCK_SERVER_HPP_
@@ -4,123 +4,1794 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <fstream>
-#include <queue>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
 
 #include <condition_variable>
 
 #include <curl/curl.h>
+#include <FLAC/stream_decoder.h>
 #include <nlohmann/json.hpp>
 #include <opus/opus.h>
+#include <opus/opus_multistream.h>
 #include <ogg/ogg.h>
 #include <portaudio.h>
 
-#include "ChatStructures.hpp"
+#define MINIMP3_FLOAT_OUTPUT // Decode straight to the float samples the audio buffer holds
+#define MINIMP3_IMPLEMENTATION
+#include <minimp3/minimp3.h>
 
-#define DEBUG 0
+#include "ChatStructures.hpp"
+#include "archive_writer.hpp"
+#include "audio_sink.hpp"
+#include "cancellation_token.hpp"
+#include "connection_pool.hpp"
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+#include "opus_header.hpp"
+#include "request_engine.hpp"
+#include "sentence_segmenter.hpp"
+#include "speech_cache.hpp"
 
 // Define constants for audio settings
 const int SAMPLE_RATE = 24000;
 const int CHANNELS = 1;
 const int FRAMES_PER_BUFFER = 960;
+const size_t AUDIO_BUFFER_CAPACITY = 1 << 21; // ~87 s of mono audio at 24 kHz
+const size_t CACHE_LINE_SIZE = 64;
 
 namespace openai {
     OpusDecoder* opusDecoder = nullptr;
     int opusError;
     
+    /**
+    * @brief Fixed-capacity single-producer/single-consumer ring buffer of decoded PCM samples
+    *
+    * The decoder is the only writer and the PortAudio callback the only reader. Each side owns one
+    * index and only reads the other one, so neither ever locks and nothing is allocated after construction.
+    */
     class AudioBuffer {
-    private:
-        std::queue<float> buffer;
-        std::mutex mutex;
-
     public:
+        /// @brief Construct a buffer holding at least `capacity` samples (rounded up to a power of two)
+        explicit AudioBuffer(size_t capacity = AUDIO_BUFFER_CAPACITY)
+            : capacity_{ roundUpToPowerOfTwo(capacity) }, mask_{ capacity_ - 1 }, data_{ new float[capacity_] } {}
+
+        AudioBuffer(const AudioBuffer&) = delete;
+        AudioBuffer& operator=(const AudioBuffer&) = delete;
+
+        /// @brief Copy up to `count` samples into the buffer (producer side)
+        /// @return Number of samples actually written, less than `count` if the buffer is full
+        size_t write(const float* data, size_t count) noexcept {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if (capacity_ - (head - cachedTail_) < count) {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+            }
+            const size_t n = std::min(count, capacity_ - (head - cachedTail_));
+            const size_t offset = head & mask_;
+            const size_t first = std::min(n, capacity_ - offset);
+            std::copy(data, data + first, data_.get() + offset);
+            std::copy(data + first, data + n, data_.get());
+            head_.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        /// @brief Copy up to `count` samples out of the buffer (consumer side)
+        /// @return Number of samples actually read, less than `count` if the buffer ran dry
+        size_t read(float* output, size_t count) noexcept {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (cachedHead_ - tail < count) {
+                cachedHead_ = head_.load(std::memory_order_acquire);
+            }
+            const size_t n = std::min(count, cachedHead_ - tail);
+            const size_t offset = tail & mask_;
+            const size_t first = std::min(n, capacity_ - offset);
+            std::copy(data_.get() + offset, data_.get() + offset + first, output);
+            std::copy(data_.get(), data_.get() + (n - first), output + first);
+            tail_.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        /// @brief Contiguous free region at the write position, for producing samples in place (producer side)
+        /// @param available Set to the number of samples that may be written at the returned pointer;
+        ///                  the region stops at the end of the storage, so it can be shorter than freeSpace()
+        float* beginWrite(size_t& available) noexcept {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            const size_t offset = head & mask_;
+            available = std::min(capacity_ - (head - cachedTail_), capacity_ - offset);
+            return data_.get() + offset;
+        }
+
+        /// @brief Publish `count` samples written into the region returned by beginWrite() (producer side)
+        void commitWrite(size_t count) noexcept {
+            head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        /// @brief Append decoded samples, counting any that do not fit as dropped
         void addData(const float* data, size_t size) {
-            std::lock_guard<std::mutex> lock(mutex);
-            for (size_t i = 0; i < size; ++i) {
-                buffer.push(data[i]);
+            size_t written = write(data, size);
+            if (written < size) {
+                dropped_.fetch_add(size - written, std::memory_order_relaxed);
+            }
+        }
+
+        /// @brief Ask the consumer to drop every sample written so far (any thread)
+        ///
+        /// Only the consumer may move the read position, so the drop happens in its next applyFlush().
+        void requestFlush() noexcept {
+            flushTo_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        /// @brief Drop the samples a requestFlush() asked for (consumer side)
+        /// @return Number of samples dropped
+        size_t applyFlush() noexcept {
+            const size_t target = flushTo_.load(std::memory_order_acquire);
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (static_cast<std::ptrdiff_t>(target - tail) <= 0) {
+                return 0;
             }
+            cachedHead_ = head_.load(std::memory_order_acquire); // read() assumes cachedHead_ is never behind tail_
+            tail_.store(target, std::memory_order_release);
+            return target - tail;
         }
 
+        /// @brief Read samples for the audio callback; never blocks
+        /// @return Number of samples read
         size_t getData(float* output, size_t framesPerBuffer) {
-            std::lock_guard<std::mutex> lock(mutex);
-            size_t i = 0;
-            for (; i < framesPerBuffer && !buffer.empty(); ++i) {
-                output[i] = buffer.front();
-                buffer.pop();
+            return read(output, framesPerBuffer);
+        }
+
+        /// @brief Number of samples that can be written without overflowing (exact for the producer)
+        size_t freeSpace() const noexcept {
+            return capacity_ - size();
+        }
+
+        /// @brief Number of samples currently buffered (approximate when called from a third thread)
+        size_t size() const noexcept {
+            return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const noexcept { return capacity_; }
+
+        /// @brief Number of samples discarded by addData() because the buffer was full
+        size_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+        bool isEmpty() const {
+            return size() == 0;
+        }
+
+    private:
+        static size_t roundUpToPowerOfTwo(size_t n) {
+            size_t p = 1;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        const size_t capacity_; ///< Number of samples the buffer can hold (power of two)
+        const size_t mask_; ///< capacity_ - 1, used to wrap indices
+        std::unique_ptr<float[]> data_; ///< Sample storage, allocated once
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{ 0 }; ///< Next write position (owned by the producer)
+        size_t cachedTail_{ 0 }; ///< Producer's last seen value of tail_
+        std::atomic<size_t> dropped_{ 0 }; ///< Samples dropped on overflow
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{ 0 }; ///< Next read position (owned by the consumer)
+        size_t cachedHead_{ 0 }; ///< Consumer's last seen value of head_
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> flushTo_{ 0 }; ///< Write position up to which the consumer should drop samples
+    };
+
+    /**
+    * @brief FIFO of compressed response chunks handed from the network thread to the decode worker
+    *
+    * Only non-real-time threads touch this queue, so a mutex and condition variable are fine here.
+    */
+    class ChunkQueue {
+    public:
+        /// @brief Append a chunk and wake the consumer
+        /// @return Queue depth (in chunks) after the push
+        size_t push(std::vector<char>&& chunk) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bytes_ += chunk.size();
+            chunks_.push_back(std::move(chunk));
+            size_t depth = chunks_.size();
+            cv_.notify_one();
+            return depth;
+        }
+
+        /// @brief Wait for the next chunk
+        /// @return false once the queue is closed and fully drained
+        bool pop(std::vector<char>& chunk) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !chunks_.empty() || closed_; });
+            if (chunks_.empty()) {
+                return false;
+            }
+            chunk = std::move(chunks_.front());
+            chunks_.pop_front();
+            bytes_ -= chunk.size();
+            return true;
+        }
+
+        /// @brief Signal that no more chunks will be pushed
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            cv_.notify_all();
+        }
+
+        /// @brief Drop every queued chunk, e.g. when the response is interrupted
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            chunks_.clear();
+            bytes_ = 0;
+        }
+
+        /// @brief Re-open a closed queue for the next response
+        void reopen() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = false;
+        }
+
+        size_t depth() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return chunks_.size();
+        }
+
+        size_t bytes() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return bytes_;
+        }
+
+    private:
+        mutable std::mutex mutex_; ///< Protects every member below
+        std::condition_variable cv_; ///< Signalled on push and close
+        std::deque<std::vector<char>> chunks_; ///< Pending compressed chunks
+        size_t bytes_{ 0 }; ///< Total bytes pending in chunks_
+        bool closed_{ false }; ///< Set once the producer is done
+    };
+
+    /// @brief Per-stage counters and timings of the receive -> decode -> archive pipeline
+    struct PipelineStats {
+        using Clock = std::chrono::steady_clock;
+
+        // Network stage (curl write callback)
+        std::atomic<size_t> chunksReceived{ 0 };
+        std::atomic<size_t> bytesReceived{ 0 };
+        std::atomic<long long> receiveNanos{ 0 }; ///< Time spent inside the write callback
+        std::atomic<size_t> maxQueueDepth{ 0 }; ///< Highest number of chunks waiting for the decoder
+
+        // Decode stage (worker thread)
+        std::atomic<size_t> packetsDecoded{ 0 };
+        std::atomic<size_t> samplesDecoded{ 0 };
+        std::atomic<long long> decodeNanos{ 0 }; ///< Time spent demuxing and decoding
+        std::atomic<long long> archiveNanos{ 0 }; ///< Time spent handing the raw stream to the archive writer
+
+        // Loss concealment (decode worker)
+        std::atomic<size_t> lostPages{ 0 }; ///< Ogg pages missing from the page sequence
+        std::atomic<size_t> duplicatePages{ 0 }; ///< Pages received again (e.g. replayed by a resumed download) and skipped
+        std::atomic<size_t> corruptPackets{ 0 }; ///< Packets the decoder rejected
+        std::atomic<size_t> corruptStreams{ 0 }; ///< Responses abandoned because their header or data could not be decoded
+        std::atomic<size_t> plcFrames{ 0 }; ///< Frames synthesized by packet loss concealment
+        std::atomic<size_t> fecFrames{ 0 }; ///< Frames recovered from in-band FEC of the following packet
+        std::atomic<size_t> concealedSamples{ 0 }; ///< Samples produced by PLC and FEC
+
+        // Milestones, in nanoseconds since start (the textToSpeech call), -1 until reached
+        Clock::time_point start{ Clock::now() };
+        std::atomic<long long> requestSentNanos{ -1 };
+        std::atomic<long long> firstByteNanos{ -1 };
+        std::atomic<long long> firstPageNanos{ -1 };
+        std::atomic<long long> firstPacketNanos{ -1 };
+        std::atomic<long long> firstAudioNanos{ -1 }; ///< First decoded PCM pulled by the audio callback
+        std::atomic<long long> lastAudioNanos{ -1 }; ///< Last sample of the response pulled by the audio callback
+        std::atomic<long long> interruptNanos{ -1 }; ///< The response was interrupted (barge-in)
+        std::atomic<long long> silencedNanos{ -1 }; ///< The audio callback finished fading out after the interruption
+
+        void reset() {
+            chunksReceived = 0;
+            bytesReceived = 0;
+            receiveNanos = 0;
+            maxQueueDepth = 0;
+            packetsDecoded = 0;
+            samplesDecoded = 0;
+            decodeNanos = 0;
+            archiveNanos = 0;
+            lostPages = 0;
+            duplicatePages = 0;
+            corruptPackets = 0;
+            corruptStreams = 0;
+            plcFrames = 0;
+            fecFrames = 0;
+            concealedSamples = 0;
+            requestSentNanos = -1;
+            firstByteNanos = -1;
+            firstPageNanos = -1;
+            firstPacketNanos = -1;
+            firstAudioNanos = -1;
+            lastAudioNanos = -1;
+            interruptNanos = -1;
+            silencedNanos = -1;
+            start = Clock::now();
+        }
+
+        static long long nanosBetween(Clock::time_point from, Clock::time_point to) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+        }
+
+        /// @brief Record a milestone the first time it is reached; cheap enough for the audio callback
+        void markOnce(std::atomic<long long>& milestone) {
+            if (milestone.load(std::memory_order_relaxed) != -1) {
+                return;
+            }
+            long long expected = -1;
+            milestone.compare_exchange_strong(expected, nanosBetween(start, Clock::now()));
+        }
+
+        void updateMaxQueueDepth(size_t depth) {
+            size_t current = maxQueueDepth.load(std::memory_order_relaxed);
+            while (depth > current && !maxQueueDepth.compare_exchange_weak(current, depth)) {}
+        }
+
+        /// @brief Snapshot of the milestones of the current request
+        LatencyTrace latency() const {
+            return LatencyTrace{ requestSentNanos.load(), firstByteNanos.load(), firstPageNanos.load(),
+                firstPacketNanos.load(), firstAudioNanos.load(), lastAudioNanos.load(), interruptNanos.load(), silencedNanos.load() };
+        }
+
+        /// @brief Decode time and bytes on the wire per second of decoded audio, to compare response formats
+        Json costJson() const {
+            double audioSeconds = static_cast<double>(samplesDecoded.load()) / CHANNELS / SAMPLE_RATE;
+            if (audioSeconds <= 0.0) {
+                return Json{ {"audio_s", 0.0} };
+            }
+            return Json{
+                {"audio_s", audioSeconds},
+                {"decode_ms_per_audio_s", decodeNanos.load() / 1e6 / audioSeconds},
+                {"wire_kbps", bytesReceived.load() * 8 / 1000.0 / audioSeconds}
+            };
+        }
+
+        Json toJson() const {
+            return Json{
+                {"network", {
+                    {"chunks", chunksReceived.load()},
+                    {"bytes", bytesReceived.load()},
+                    {"callback_ms", receiveNanos.load() / 1e6},
+                    {"max_queue_depth", maxQueueDepth.load()}
+                }},
+                {"decode", {
+                    {"packets", packetsDecoded.load()},
+                    {"samples", samplesDecoded.load()},
+                    {"decode_ms", decodeNanos.load() / 1e6},
+                    {"archive_ms", archiveNanos.load() / 1e6}
+                }},
+                {"cost", costJson()},
+                {"concealment", {
+                    {"lost_pages", lostPages.load()},
+                    {"duplicate_pages", duplicatePages.load()},
+                    {"corrupt_packets", corruptPackets.load()},
+                    {"corrupt_streams", corruptStreams.load()},
+                    {"plc_frames", plcFrames.load()},
+                    {"fec_frames", fecFrames.load()},
+                    {"concealed_ms", concealedSamples.load() / CHANNELS * 1000.0 / SAMPLE_RATE}
+                }},
+                {"latency", latency().toJson()}
+            };
+        }
+    };
+
+    /// @brief A span of pre-decoded PCM (e.g. in a memory-mapped PhraseBank) played without copying or decoding
+    struct PcmClip {
+        const float* samples; ///< Interleaved samples at SAMPLE_RATE / CHANNELS
+        size_t count; ///< Number of samples
+    };
+
+    /// @brief Counters kept by the audio callback
+    struct PlaybackStats {
+        std::atomic<size_t> callbacks{ 0 }; ///< Callback invocations
+        std::atomic<size_t> samplesPlayed{ 0 }; ///< Samples copied to the device
+        std::atomic<size_t> silentCallbacks{ 0 }; ///< Callbacks that found no data to play
+        std::atomic<size_t> underruns{ 0 }; ///< Buffer ran dry while the response was still streaming
+        std::atomic<size_t> interruptions{ 0 }; ///< Responses faded out and flushed by an interruption
+        std::atomic<size_t> flushedSamples{ 0 }; ///< Decoded samples dropped by interruptions
+
+        Json toJson() const {
+            return Json{
+                {"callbacks", callbacks.load()},
+                {"samples_played", samplesPlayed.load()},
+                {"silent_callbacks", silentCallbacks.load()},
+                {"underruns", underruns.load()},
+                {"interruptions", interruptions.load()},
+                {"flushed_samples", flushedSamples.load()}
+            };
+        }
+    };
+
+    /**
+    * @brief Prebuffer policy of the audio callback, adapted to the measured arrival jitter
+    *
+    * Playback of a response starts once the buffer holds the target amount of audio, or once it stops
+    * growing for that long (a short response, or a producer that never signals the end). The decode
+    * worker estimates interarrival jitter of decoded packets against their media time (RFC 3550
+    * style) and the target follows three times that estimate. Every underrun raises a floor under the
+    * target by half; a second of clean playback lowers it again by a sixteenth, down to minMs.
+    */
+    struct JitterBuffer {
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr size_t FADE_SAMPLES = SAMPLE_RATE / 400 * CHANNELS; ///< 2.5 ms fade around underruns
+
+        // Configuration; set before playback starts
+        int prebufferMs{ 80 }; ///< Initial target
+        int minMs{ 20 }; ///< Lowest target the adaptation may reach
+        int maxMs{ 600 }; ///< Highest target the adaptation may reach
+
+        std::atomic<long long> jitterNanos{ 0 }; ///< Interarrival jitter estimate (decode worker)
+        std::atomic<size_t> targetSamples{ 0 }; ///< Target used for the latest (re)start, for reporting
+        std::atomic<size_t> rebuffers{ 0 }; ///< Times playback was resumed after an underrun
+
+        /// @brief Forget the transit time of the previous response (decode worker)
+        void startStream() {
+            streamStart_ = Clock::now();
+            mediaSamples_ = 0;
+            haveTransit_ = false;
+        }
+
+        /// @brief Update the jitter estimate with a decoded packet of `samples` samples (decode worker)
+        void onPacket(size_t samples) {
+            long long mediaNanos = static_cast<long long>(mediaSamples_ / CHANNELS * 1000000000ull / SAMPLE_RATE);
+            long long transit = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - streamStart_).count() - mediaNanos;
+            mediaSamples_ += samples;
+            if (haveTransit_) {
+                long long deviation = transit > lastTransit_ ? transit - lastTransit_ : lastTransit_ - transit;
+                long long jitter = jitterNanos.load(std::memory_order_relaxed);
+                jitterNanos.store(jitter + (deviation - jitter) / 16, std::memory_order_relaxed);
+            }
+            lastTransit_ = transit;
+            haveTransit_ = true;
+        }
+
+        /// @brief Samples to buffer before (re)starting playback (audio callback)
+        size_t target() {
+            if (floorSamples_ == 0) {
+                floorSamples_ = msToSamples(prebufferMs);
+            }
+            size_t fromJitter = static_cast<size_t>(3 * jitterNanos.load(std::memory_order_relaxed) / 1000 * SAMPLE_RATE / 1000000) * CHANNELS;
+            return std::clamp(std::max(floorSamples_, fromJitter), msToSamples(minMs), msToSamples(maxMs));
+        }
+
+        /// @brief Whether playback should (re)start with `available` samples buffered (audio callback)
+        bool ready(size_t available, size_t callbackSamples, bool decoded) {
+            if (decoded && available > 0) {
+                return true;
+            }
+            size_t goal = target();
+            targetSamples.store(goal, std::memory_order_relaxed);
+            if (available != lastAvailable_) {
+                lastAvailable_ = available;
+                stalledSamples_ = 0;
+            }
+            else if (available > 0) {
+                stalledSamples_ += callbackSamples;
+            }
+            return available >= goal || (available > 0 && stalledSamples_ >= goal);
+        }
+
+        /// @brief Playback starts or resumes: fade the first samples in (audio callback)
+        void onStart() {
+            playing_ = true;
+            fadeInPosition_ = 0;
+            lastAvailable_ = 0;
+            stalledSamples_ = 0;
+        }
+
+        /// @brief The buffer ran dry while the response was still streaming (audio callback)
+        void onUnderrun() {
+            playing_ = false;
+            stableSamples_ = 0;
+            floorSamples_ = std::min(floorSamples_ + floorSamples_ / 2, msToSamples(maxMs));
+            rebuffers.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// @brief The response has been played completely (audio callback)
+        void onDrained() {
+            playing_ = false;
+        }
+
+        /// @brief Fade in after a (re)start and relax the floor after clean playback (audio callback)
+        void onPlayed(float* out, size_t samples) {
+            for (size_t i = 0; i < samples && fadeInPosition_ < FADE_SAMPLES; ++i, ++fadeInPosition_) {
+                out[i] *= static_cast<float>(fadeInPosition_) / FADE_SAMPLES;
+            }
+            stableSamples_ += samples;
+            if (stableSamples_ >= static_cast<size_t>(SAMPLE_RATE) * CHANNELS) {
+                stableSamples_ = 0;
+                floorSamples_ = std::max(floorSamples_ - floorSamples_ / 16, msToSamples(minMs));
+            }
+        }
+
+        bool playing() const { return playing_; }
+
+        Json toJson() const {
+            return Json{
+                {"jitter_ms", jitterNanos.load() / 1e6},
+                {"target_ms", targetSamples.load() / CHANNELS * 1000.0 / SAMPLE_RATE},
+                {"rebuffers", rebuffers.load()}
+            };
+        }
+
+    private:
+        static size_t msToSamples(int ms) {
+            return static_cast<size_t>(ms) * SAMPLE_RATE / 1000 * CHANNELS;
+        }
+
+        // Decode worker only
+        Clock::time_point streamStart_{ Clock::now() };
+        size_t mediaSamples_{ 0 };
+        long long lastTransit_{ 0 };
+        bool haveTransit_{ false };
+
+        // Audio callback only
+        bool playing_{ false };
+        size_t floorSamples_{ 0 }; ///< Adapted lower bound of the target, 0 until first used
+        size_t fadeInPosition_{ FADE_SAMPLES };
+        size_t stableSamples_{ 0 }; ///< Samples played since the last underrun or relaxation
+        size_t lastAvailable_{ 0 };
+        size_t stalledSamples_{ 0 }; ///< Callback time for which the buffer has not grown
+    };
+
+    /// @brief Encodings the speech endpoint can return, named as in its `response_format` field
+    enum class AudioFormat { Opus, Mp3, Aac, Flac, Wav, Pcm };
+
+    inline const char* audioFormatToString(AudioFormat format) {
+        switch (format) {
+        case AudioFormat::Opus: return "opus";
+        case AudioFormat::Mp3: return "mp3";
+        case AudioFormat::Aac: return "aac";
+        case AudioFormat::Flac: return "flac";
+        case AudioFormat::Wav: return "wav";
+        case AudioFormat::Pcm: return "pcm";
+        }
+        return "unknown";
+    }
+
+    /// @return false if `name` is not a response_format the API knows
+    inline bool parseAudioFormat(const std::string& name, AudioFormat& format) {
+        for (AudioFormat candidate : { AudioFormat::Opus, AudioFormat::Mp3, AudioFormat::Aac, AudioFormat::Flac, AudioFormat::Wav, AudioFormat::Pcm }) {
+            if (name == audioFormatToString(candidate)) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Whether a StreamDecoder exists for `format`; no AAC decoder is linked in
+    inline bool canDecode(AudioFormat format) {
+        return format != AudioFormat::Aac;
+    }
+
+    /**
+    * @brief Incremental decoder of one response format into the audio buffer
+    *
+    * The decode worker hands it the response in network-sized chunks, in order. It keeps whatever a
+    * chunk leaves incomplete until the next one arrives, and writes the decoded audio, converted to
+    * CHANNELS, into the ring buffer as soon as each frame is complete.
+    */
+    class StreamDecoder {
+    public:
+        StreamDecoder(AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter)
+            : buffer_{ buffer }, stats_{ stats }, jitter_{ jitter } {}
+
+        virtual ~StreamDecoder() = default;
+
+        StreamDecoder(const StreamDecoder&) = delete;
+        StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+        virtual AudioFormat format() const = 0;
+
+        /// @brief Prepare for a new response
+        virtual void start() = 0;
+
+        /// @brief Decode the next chunk of the response
+        virtual void decode(const char* data, size_t size) = 0;
+
+        /// @brief The response is complete: decode whatever is still buffered
+        virtual void finish() {}
+
+        /// @brief Layout of the stream decoded so far
+        virtual Json toJson() const {
+            return Json{ {"format", audioFormatToString(format())}, {"sample_rate", sampleRate_}, {"channels", channels_} };
+        }
+
+    protected:
+        /// @brief Record the layout of the stream; there is no resampler, so other rates play at the wrong speed
+        void setStreamFormat(int sampleRate, int channels) {
+            if (sampleRate != SAMPLE_RATE && sampleRate != sampleRate_) {
+                OPENAI_LOG_WARN("sample_rate_mismatch", "%s stream is %d Hz, playback runs at %d Hz", audioFormatToString(format()), sampleRate, SAMPLE_RATE);
+            }
+            sampleRate_ = sampleRate;
+            channels_ = channels;
+        }
+
+        /// @brief Convert `frames` frames of the stream's channels to CHANNELS in place and append them to the buffer
+        ///
+        /// `pcm` must have room for max(channels_, CHANNELS) samples per frame.
+        void output(float* pcm, size_t frames) {
+            if (channels_ != CHANNELS) {
+                mixToOutputChannels(pcm, frames, channels_);
+            }
+            buffer_.addData(pcm, frames * CHANNELS);
+            packetDecoded(frames);
+        }
+
+        /// @brief Account for `frames` frames that have been written to the buffer
+        void packetDecoded(size_t frames) {
+            stats_.packetsDecoded += 1;
+            stats_.samplesDecoded += frames * CHANNELS;
+            stats_.markOnce(stats_.firstPacketNanos);
+            jitter_.onPacket(frames * CHANNELS);
+        }
+
+        /// @brief Convert `frames` interleaved frames of `streamChannels` channels to CHANNELS, in place
+        static void mixToOutputChannels(float* pcm, size_t frames, int streamChannels) {
+            if (streamChannels > CHANNELS) {
+                // Downmix: output channel c averages every stream channel that maps onto it
+                for (size_t frame = 0; frame < frames; ++frame) {
+                    for (int c = 0; c < CHANNELS; ++c) {
+                        float sum = 0.0f;
+                        int count = 0;
+                        for (int source = c; source < streamChannels; source += CHANNELS) {
+                            sum += pcm[frame * streamChannels + source];
+                            ++count;
+                        }
+                        pcm[frame * CHANNELS + c] = sum / count;
+                    }
+                }
+            }
+            else {
+                // Upmix, back to front so no sample is overwritten before it is read
+                for (size_t frame = frames; frame-- > 0;) {
+                    for (int c = CHANNELS; c-- > 0;) {
+                        pcm[frame * CHANNELS + c] = pcm[frame * streamChannels + c % streamChannels];
+                    }
+                }
+            }
+        }
+
+        AudioBuffer& buffer_; ///< Ring buffer played by the audio callback
+        PipelineStats& stats_;
+        JitterBuffer& jitter_;
+        int sampleRate_{ 0 }; ///< Rate of the stream, 0 until known
+        int channels_{ 0 }; ///< Channels of the stream, 0 until known
+    };
+
+    /**
+    * @brief Ogg Opus ("opus") decoder with loss concealment
+    *
+    * Pages replayed by a resumed download are skipped. Gaps in the page sequence are measured with
+    * the granule positions and filled by PLC and FEC before the next packet is decoded. Opus decodes
+    * at any rate, so the stream always comes out at SAMPLE_RATE.
+    */
+    class OggOpusDecoder : public StreamDecoder {
+    public:
+        OggOpusDecoder(AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter)
+            : StreamDecoder(buffer, stats, jitter), decodeScratch(MAX_FRAME_SIZE * CHANNELS) {
+            // Initialize the Ogg sync state
+            ogg_sync_init(&oy);
+            opusDecoder = opus_decoder_create(SAMPLE_RATE, CHANNELS, &opusError);
+            if (opusError != OPUS_OK) {
+                throw std::runtime_error("Failed to create Opus decoder: " + std::string(opus_strerror(opusError)));
+            }
+            sampleRate_ = SAMPLE_RATE;
+            channels_ = CHANNELS;
+        }
+
+        ~OggOpusDecoder() override {
+            if (opusDecoder) {
+                opus_decoder_destroy(opusDecoder);
+            }
+            if (msDecoder) {
+                opus_multistream_decoder_destroy(msDecoder);
+            }
+            if (oggInitialized) {
+                ogg_stream_clear(&os);
+            }
+            ogg_sync_clear(&oy);
+        }
+
+        AudioFormat format() const override { return AudioFormat::Opus; }
+
+        void start() override {
+            ogg_sync_reset(&oy); // Drop any partial page left by a response that was cut off
+            serial_number = -1; // The response starts a new logical stream, even if it reuses the serial
+        }
+
+        /// @brief Demux Ogg pages from a chunk and decode the contained Opus packets
+        void decode(const char* data, size_t size) override {
+            // Buffer to store the incoming Ogg data
+            char* buffer = ogg_sync_buffer(&oy, size);
+            memcpy(buffer, data, size);
+            ogg_sync_wrote(&oy, size);
+
+            // Process the Ogg pages and extract Opus packets
+            while (ogg_sync_pageout(&oy, &og) == 1) {
+                stats_.markOnce(stats_.firstPageNanos);
+                int serial = ogg_page_serialno(&og);
+                if (!oggInitialized || serial_number == -1 || (ogg_page_bos(&og) && serial != serial_number)) {
+                    // First page, or a new logical stream (e.g. a download restarted from the beginning)
+                    startLogicalStream(serial);
+                }
+                if (streamFailed) {
+                    continue; // No decoder for this stream's layout; wait for a new logical stream
+                }
+
+                long pageNumber = ogg_page_pageno(&og);
+                if (lastPageNumber >= 0 && pageNumber <= lastPageNumber) {
+                    stats_.duplicatePages += 1;
+                    continue;
+                }
+                long missingPages = lastPageNumber >= 0 ? pageNumber - lastPageNumber - 1 : 0;
+                lastPageNumber = pageNumber;
+                stats_.lostPages += missingPages;
+
+                if (ogg_stream_pagein(&os, &og) != 0) {
+                    OPENAI_LOG_WARN("ogg_page_rejected", "Failed to read Ogg page into stream");
+                    continue;
+                }
+
+                // Collect the completed packets; they stay valid until the next page is read in
+                pagePackets.clear();
+                int result;
+                while ((result = ogg_stream_packetout(&os, &op)) != 0) {
+                    if (result == 1) { // -1 marks the hole left by a lost page, measured below instead
+                        pagePackets.push_back(op);
+                    }
+                }
+                decodePage(missingPages);
+            }
+        }
+
+        Json toJson() const override {
+            Json json = StreamDecoder::toJson();
+            json["opus_head"] = opusHead.toJson();
+            json["opus_tags"] = opusTags.toJson();
+            return json;
+        }
+
+        /// @brief Identification header of the current stream
+        const OpusHead& head() const { return opusHead; }
+
+        /// @brief Comment header of the current stream
+        const OpusTags& tags() const { return opusTags; }
+
+    private:
+        /// @brief Conceal whatever precedes the packets of the current page, then decode them
+        void decodePage(long missingPages) {
+            // Granule positions count 48 kHz samples at the end of the last packet completed on a page
+            ogg_int64_t pageSamples = 0;
+            const ogg_packet* firstAudioPacket = nullptr;
+            for (const ogg_packet& packet : pagePackets) {
+                if (isHeaderPacket(packet)) {
+                    continue;
+                }
+                int samples = opus_packet_get_nb_samples(packet.packet, packet.bytes, GRANULE_RATE);
+                if (samples > 0) {
+                    pageSamples += samples;
+                    if (!firstAudioPacket) {
+                        firstAudioPacket = &packet;
+                    }
+                }
+            }
+
+            ogg_int64_t granule = ogg_page_granulepos(&og);
+            ogg_int64_t gap = 0;
+            if (granule >= 0 && pageSamples > 0) {
+                gap = granule - pageSamples - decodedGranule;
+            }
+            else if (missingPages > 0) {
+                gap = missingPages * lastPageSamples; // No timing on this page: assume the lost ones were alike
+            }
+            if (gap > 0) {
+                conceal(gap, firstAudioPacket);
+            }
+            if (pageSamples > 0) {
+                lastPageSamples = pageSamples;
+            }
+
+            // The last page of a stream ends at its granule position; anything decoded past it is padding
+            ogg_int64_t streamEnd = ogg_page_eos(&og) && granule >= 0 ? granule : -1;
+
+            for (const ogg_packet& packet : pagePackets) {
+                if (isHeaderPacket(packet)) {
+                    readHeader(packet);
+                    continue;
+                }
+
+                // Decode the Opus packet, sized from its TOC so every duration from 2.5 to 120 ms fits
+                int frameSize = opus_packet_get_nb_samples(packet.packet, packet.bytes, SAMPLE_RATE);
+                size_t keepFrames = static_cast<size_t>(-1);
+                if (streamEnd >= 0 && decodedGranule + static_cast<ogg_int64_t>(frameSize) * GRANULE_RATE / SAMPLE_RATE > streamEnd) {
+                    keepFrames = static_cast<size_t>(std::max<ogg_int64_t>(0, streamEnd - decodedGranule) * SAMPLE_RATE / GRANULE_RATE);
+                }
+                if (frameSize > 0) {
+                    frameSize = decodeToBuffer(packet.packet, packet.bytes, frameSize, 0, keepFrames);
+                }
+                if (frameSize <= 0) {
+                    // A corrupt packet is a lost packet: conceal its duration
+                    OPENAI_LOG_WARN("opus_decode_error", "%s", opus_strerror(frameSize));
+                    stats_.corruptPackets += 1;
+                    int samples = opus_packet_get_nb_samples(packet.packet, packet.bytes, GRANULE_RATE);
+                    if (samples > 0) {
+                        conceal(samples, nullptr);
+                    }
+                    continue;
+                }
+
+                decodedGranule += static_cast<ogg_int64_t>(frameSize) * GRANULE_RATE / SAMPLE_RATE;
+                packetDecoded(frameSize);
+            }
+        }
+
+        /// @brief Fill `gap` (48 kHz samples) of missing audio
+        ///
+        /// The last missing frame is recovered from the in-band FEC of `next` when available (the
+        /// decoder falls back to PLC if the packet carries none); the rest is synthesized by PLC.
+        void conceal(ogg_int64_t gap, const ogg_packet* next) {
+            decodedGranule += gap;
+            ogg_int64_t samples = std::min<ogg_int64_t>(gap * SAMPLE_RATE / GRANULE_RATE, MAX_CONCEALED_FRAMES);
+
+            int fecSize = next ? opus_packet_get_nb_samples(next->packet, next->bytes, SAMPLE_RATE) : 0;
+            if (fecSize <= 0 || fecSize > samples) {
+                fecSize = 0;
+            }
+
+            ogg_int64_t plcSamples = samples - fecSize;
+            while (plcSamples >= PLC_GRANULARITY) {
+                // PLC frame sizes must be multiples of 2.5 ms
+                int frameSize = static_cast<int>(std::min<ogg_int64_t>(plcSamples, PLC_FRAME) / PLC_GRANULARITY * PLC_GRANULARITY);
+                int decoded = decodeToBuffer(nullptr, 0, frameSize, 0);
+                if (decoded <= 0) {
+                    break;
+                }
+                stats_.plcFrames += 1;
+                stats_.concealedSamples += decoded * CHANNELS;
+                plcSamples -= decoded;
+            }
+
+            if (fecSize > 0) {
+                int decoded = decodeToBuffer(next->packet, next->bytes, fecSize, 1);
+                if (decoded > 0) {
+                    stats_.fecFrames += 1;
+                    stats_.concealedSamples += decoded * CHANNELS;
+                }
+            }
+        }
+
+        /// @brief Decode one packet, or conceal one frame when `data` is null, straight into the audio buffer
+        ///
+        /// `frameSize` must be the packet's duration (or the frame to conceal) in samples per channel.
+        /// Pending pre-skip is trimmed from the front and at most `keepFrames` frames are kept. When the
+        /// stream has CHANNELS channels the decoder writes into the ring's free region; otherwise, or when
+        /// that region is cut short by the end of the storage or a full buffer, it goes through the
+        /// preallocated scratch buffer, where other channel counts are mixed to CHANNELS.
+        /// @return Samples per channel decoded (before trimming), or an Opus error code
+        int decodeToBuffer(const unsigned char* data, opus_int32 bytes, int frameSize, int decodeFec, size_t keepFrames = static_cast<size_t>(-1)) {
+            if (frameSize > MAX_FRAME_SIZE) {
+                return OPUS_INVALID_PACKET;
+            }
+            if (!msDecoder && !opusDecoder) {
+                return OPUS_INVALID_STATE; // A previous stream's layout could not be set up
+            }
+            const int streamChannels = opusHead.channels;
+            size_t needed = static_cast<size_t>(frameSize) * CHANNELS;
+            size_t available = 0;
+            float* region = buffer_.beginWrite(available);
+            bool inPlace = streamChannels == CHANNELS && available >= needed;
+            float* pcm = inPlace ? region : decodeScratch.data();
+
+            int decoded = msDecoder
+                ? opus_multistream_decode_float(msDecoder, data, bytes, pcm, frameSize, decodeFec)
+                : opus_decode_float(opusDecoder, data, bytes, pcm, frameSize, decodeFec);
+            if (decoded <= 0) {
+                return decoded;
+            }
+
+            size_t skip = std::min(pendingPreSkip, static_cast<size_t>(decoded));
+            pendingPreSkip -= skip;
+            size_t keep = std::min(static_cast<size_t>(decoded) - skip, keepFrames);
+            if (streamChannels != CHANNELS) {
+                mixToOutputChannels(pcm, static_cast<size_t>(decoded), streamChannels);
+            }
+
+            if (inPlace) {
+                if (skip > 0) {
+                    std::copy(region + skip * CHANNELS, region + (skip + keep) * CHANNELS, region);
+                }
+                buffer_.commitWrite(keep * CHANNELS);
+            }
+            else {
+                buffer_.addData(pcm + skip * CHANNELS, keep * CHANNELS);
+            }
+            return decoded;
+        }
+
+        /// @brief Apply an OpusHead or OpusTags header packet
+        void readHeader(const ogg_packet& packet) {
+            if (std::memcmp(packet.packet, "OpusTags", 8) == 0) {
+                OpusTags::parse(packet.packet, packet.bytes, opusTags);
+                return;
+            }
+            OpusHead head;
+            if (!OpusHead::parse(packet.packet, packet.bytes, head)) {
+                OPENAI_LOG_WARN("invalid_opus_head", "Invalid OpusHead header, decoding as mono");
+                return;
+            }
+            configureDecoder(head);
+        }
+
+        /// @brief Set up the decoder for the channel layout, pre-skip and gain of a stream header
+        void configureDecoder(const OpusHead& head) {
+            opusHead = head;
+            channels_ = head.channels;
+            pendingPreSkip = static_cast<size_t>(head.preSkip) * SAMPLE_RATE / GRANULE_RATE;
+
+            if (msDecoder) {
+                opus_multistream_decoder_destroy(msDecoder);
+                msDecoder = nullptr;
+            }
+            if (head.mappingFamily != 0) {
+                msDecoder = opus_multistream_decoder_create(SAMPLE_RATE, head.channels, head.streams, head.coupledStreams, head.mapping.data(), &opusError);
+                if (opusError != OPUS_OK) {
+                    msDecoder = nullptr;
+                    abandonStream("Failed to create Opus multistream decoder");
+                    return;
+                }
+                opus_multistream_decoder_ctl(msDecoder, OPUS_SET_GAIN(head.outputGain));
+            }
+            else {
+                if (opusDecoder && decoderChannels != head.channels) {
+                    opus_decoder_destroy(opusDecoder);
+                    opusDecoder = nullptr;
+                }
+                if (!opusDecoder) {
+                    opusDecoder = opus_decoder_create(SAMPLE_RATE, head.channels, &opusError);
+                    if (opusError != OPUS_OK) {
+                        opusDecoder = nullptr;
+                        abandonStream("Failed to create Opus decoder");
+                        return;
+                    }
+                    decoderChannels = head.channels;
+                }
+                opus_decoder_ctl(opusDecoder, OPUS_RESET_STATE);
+                opus_decoder_ctl(opusDecoder, OPUS_SET_GAIN(head.outputGain));
+            }
+
+            size_t scratchSize = static_cast<size_t>(MAX_FRAME_SIZE) * std::max(head.channels, CHANNELS);
+            if (decodeScratch.size() < scratchSize) {
+                decodeScratch.resize(scratchSize);
+            }
+        }
+
+        /// @brief Stop decoding the current logical stream, whose header describes a layout the decoder rejects
+        ///
+        /// Runs on the decode worker, so a corrupt response is logged and skipped instead of throwing.
+        void abandonStream(const char* reason) {
+            OPENAI_LOG_ERROR("opus_stream_abandoned", "%s: %s", reason, opus_strerror(opusError));
+            stats_.corruptStreams += 1;
+            streamFailed = true;
+        }
+
+        /// @brief Reset the demuxer and decoder for a new logical Ogg stream
+        void startLogicalStream(int serial) {
+            if (oggInitialized) {
+                ogg_stream_clear(&os);
+            }
+            if (ogg_stream_init(&os, serial) != 0) {
+                throw std::runtime_error("Failed to initialize Ogg stream state.");
+            }
+            serial_number = serial;
+            oggInitialized = true;
+            streamFailed = false;
+            lastPageNumber = -1;
+            decodedGranule = 0;
+            lastPageSamples = 0;
+            pendingPreSkip = 0;
+            if (opusDecoder) {
+                opus_decoder_ctl(opusDecoder, OPUS_RESET_STATE);
+            }
+            if (msDecoder) {
+                opus_multistream_decoder_ctl(msDecoder, OPUS_RESET_STATE);
+            }
+        }
+
+        /// @brief Whether `packet` is an OpusHead or OpusTags header rather than audio
+        static bool isHeaderPacket(const ogg_packet& packet) {
+            return packet.bytes >= 8 && (std::memcmp(packet.packet, "OpusHead", 8) == 0 || std::memcmp(packet.packet, "OpusTags", 8) == 0);
+        }
+
+        static constexpr int MAX_FRAME_SIZE = SAMPLE_RATE * 120 / 1000; // Longest Opus packet: 120 ms
+        static constexpr ogg_int64_t GRANULE_RATE = 48000; // Ogg Opus granule positions are always at 48 kHz
+        static constexpr int PLC_GRANULARITY = SAMPLE_RATE / 400; // 2.5 ms
+        static constexpr int PLC_FRAME = SAMPLE_RATE / 50; // Conceal in 20 ms frames
+        static constexpr ogg_int64_t MAX_CONCEALED_FRAMES = SAMPLE_RATE; // Longer gaps are cut to 1 s; PLC has faded to silence by then
+
+        ogg_sync_state oy;          // Ogg sync state, for syncing with the Ogg stream
+        ogg_stream_state os;        // Ogg stream state, for handling logical streams
+        ogg_page og;                // Ogg page, a single unit of data in an Ogg stream
+        ogg_packet op;              // Ogg packet, contains encoded Opus data
+        OpusDecoder* opusDecoder = nullptr;  // Opus decoder state for mono and stereo streams
+        OpusMSDecoder* msDecoder = nullptr;  // Decoder for multistream (mapping family 1 and 255) streams
+        int opusError = OPUS_OK;    // Error code returned by Opus functions
+        OpusHead opusHead;          // Identification header of the current stream
+        OpusTags opusTags;          // Comment header of the current stream
+        bool oggInitialized = false; // Flag to track if the Ogg stream state has been initialized
+        bool streamFailed = false;  // The current logical stream could not be set up and is skipped
+        int serial_number = -1;     // Serial number for the Ogg stream
+
+        // Loss tracking state
+        long lastPageNumber = -1;                // Sequence number of the last page read into the stream
+        ogg_int64_t decodedGranule = 0;          // Stream position decoded or concealed so far, in 48 kHz samples
+        ogg_int64_t lastPageSamples = 0;         // Audio carried by the last page with packets, in 48 kHz samples
+        std::vector<ogg_packet> pagePackets;     // Packets completed by the current page
+        std::vector<float> decodeScratch;        // Fallback decode target when the ring's free region wraps
+        size_t pendingPreSkip = 0;               // Decoded samples per channel still to discard at the stream start
+        int decoderChannels = CHANNELS;          // Channel count opusDecoder was created with
+    };
+
+    /**
+    * @brief MP3 ("mp3") decoder built on minimp3's frame decoder
+    *
+    * Received bytes are appended to a carry-over buffer and mp3dec_decode_frame is only called once a
+    * whole frame and the next header are buffered, since it drops a partial frame as garbage. Frames
+    * are decoded into the ring's free region when it is large enough, otherwise through a scratch
+    * buffer allocated once. The consumed prefix of the carry-over is only discarded once it makes up
+    * half of the buffer, as in SseParser.
+    */
+    class Mp3Decoder : public StreamDecoder {
+    public:
+        Mp3Decoder(AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter)
+            : StreamDecoder(buffer, stats, jitter), scratch_(MINIMP3_MAX_SAMPLES_PER_FRAME) {
+            carry_.reserve(4 * MAX_FRAME_BYTES);
+        }
+
+        AudioFormat format() const override { return AudioFormat::Mp3; }
+
+        void start() override {
+            mp3dec_init(&decoder_);
+            carry_.clear();
+            start_ = 0;
+        }
+
+        void decode(const char* data, size_t size) override {
+            carry_.insert(carry_.end(), reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size);
+            decodeAvailable(false);
+        }
+
+        void finish() override {
+            decodeAvailable(true);
+            carry_.clear();
+            start_ = 0;
+        }
+
+    private:
+        /// @brief Decode frames from the carry-over while whole frames are buffered, or all of it when `final`
+        void decodeAvailable(bool final) {
+            while (start_ < carry_.size()) {
+                const uint8_t* frame = carry_.data() + start_;
+                size_t remaining = carry_.size() - start_;
+
+                // The decoder confirms sync with the header following the frame, so wait for that too
+                if (!final) {
+                    size_t length = remaining >= 4 ? frameLength(frame) : 0;
+                    size_t needed = length > 0 ? length + 4 : 2 * MAX_FRAME_BYTES; // Unknown: ID3 tag, free format or junk
+                    if (remaining < needed) {
+                        break;
+                    }
+                }
+
+                size_t available = 0;
+                float* region = buffer_.beginWrite(available);
+                bool inPlace = available >= MINIMP3_MAX_SAMPLES_PER_FRAME;
+                float* pcm = inPlace ? region : scratch_.data();
+
+                mp3dec_frame_info_t info;
+                int samples = mp3dec_decode_frame(&decoder_, frame, static_cast<int>(remaining), pcm, &info);
+                if (info.frame_bytes == 0) {
+                    break; // Needs more data
+                }
+                start_ += info.frame_bytes;
+                if (samples <= 0) {
+                    continue; // Skipped a tag or invalid data
+                }
+
+                setStreamFormat(info.hz, info.channels);
+                if (!inPlace) {
+                    output(pcm, static_cast<size_t>(samples));
+                    continue;
+                }
+                if (channels_ != CHANNELS) {
+                    mixToOutputChannels(pcm, static_cast<size_t>(samples), channels_);
+                }
+                buffer_.commitWrite(static_cast<size_t>(samples) * CHANNELS);
+                packetDecoded(static_cast<size_t>(samples));
+            }
+
+            // Drop the consumed prefix once it dominates the buffer (amortized linear)
+            if (start_ == carry_.size()) {
+                carry_.clear();
+                start_ = 0;
+            }
+            else if (start_ > carry_.size() / 2) {
+                carry_.erase(carry_.begin(), carry_.begin() + start_);
+                start_ = 0;
+            }
+        }
+
+        /// @brief Length in bytes of the MPEG audio frame whose header starts at `header`, 0 if unknown
+        static size_t frameLength(const uint8_t* header) {
+            if (header[0] != 0xFF || (header[1] & 0xE0) != 0xE0) {
+                return 0;
+            }
+            int version = (header[1] >> 3) & 3; // 3: MPEG-1, 2: MPEG-2, 0: MPEG-2.5
+            int layer = 4 - ((header[1] >> 1) & 3); // 1, 2 or 3
+            int bitrateIndex = header[2] >> 4;
+            int rateIndex = (header[2] >> 2) & 3;
+            int padding = (header[2] >> 1) & 1;
+            if (version == 1 || layer == 4 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) {
+                return 0; // Reserved values, or free format whose length is not in the header
+            }
+
+            static const int bitrates[2][3][15] = {
+                { // MPEG-1, layers I, II, III
+                    { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+                    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+                    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 } },
+                { // MPEG-2 and 2.5, layers I, II, III
+                    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+                    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+                    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 } } };
+            static const int rates[3] = { 44100, 48000, 32000 };
+
+            bool mpeg1 = version == 3;
+            int bitrate = bitrates[mpeg1 ? 0 : 1][layer - 1][bitrateIndex] * 1000;
+            int rate = rates[rateIndex] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+            if (layer == 1) {
+                return static_cast<size_t>((12 * bitrate / rate + padding) * 4);
+            }
+            int coefficient = layer == 3 && !mpeg1 ? 72 : 144;
+            return static_cast<size_t>(coefficient * bitrate / rate + padding);
+        }
+
+        static constexpr size_t MAX_FRAME_BYTES = 2304; ///< Largest frame minimp3 accepts (free format)
+
+        mp3dec_t decoder_;
+        std::vector<uint8_t> carry_; ///< Received bytes not yet discarded
+        size_t start_{ 0 }; ///< First byte of carry_ not yet decoded
+        std::vector<float> scratch_; ///< Decode target when the ring's free region is too short
+    };
+
+    /**
+    * @brief FLAC ("flac") decoder built on libFLAC's stream decoder
+    *
+    * libFLAC pulls its input through a read callback and cannot be paused halfway through a frame, so
+    * a frame is only decoded once the metadata, or the largest frame STREAMINFO allows, is buffered.
+    * The tell callback lets the decoder report how much of what it was handed is still unconsumed.
+    */
+    class FlacDecoder : public StreamDecoder {
+    public:
+        FlacDecoder(AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter)
+            : StreamDecoder(buffer, stats, jitter), decoder_{ FLAC__stream_decoder_new() } {
+            if (!decoder_) {
+                throw std::runtime_error("Failed to create FLAC decoder.");
+            }
+        }
+
+        ~FlacDecoder() override {
+            FLAC__stream_decoder_delete(decoder_);
+        }
+
+        AudioFormat format() const override { return AudioFormat::Flac; }
+
+        void start() override {
+            FLAC__stream_decoder_finish(decoder_);
+            input_.clear();
+            position_ = 0;
+            handedOut_ = 0;
+            metadataDone_ = false;
+            finished_ = false;
+            failed_ = false;
+            maxFrameBytes_ = 0;
+            FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_stream(decoder_, readCallback, nullptr, tellCallback,
+                nullptr, nullptr, writeCallback, metadataCallback, errorCallback, this);
+            if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+                throw std::runtime_error(std::string("Failed to initialize FLAC decoder: ") + FLAC__StreamDecoderInitStatusString[status]);
+            }
+        }
+
+        void decode(const char* data, size_t size) override {
+            if (position_ > input_.size() / 2) {
+                input_.erase(input_.begin(), input_.begin() + position_);
+                position_ = 0;
+            }
+            input_.insert(input_.end(), data, data + size);
+            if (failed_) {
+                return;
+            }
+
+            if (!metadataDone_) {
+                if (!metadataBuffered()) {
+                    return;
+                }
+                if (!FLAC__stream_decoder_process_until_end_of_metadata(decoder_)) {
+                    reportFailure();
+                    return;
+                }
+                metadataDone_ = true;
+            }
+            while (frameBuffered()) {
+                if (!FLAC__stream_decoder_process_single(decoder_)) {
+                    reportFailure();
+                    return;
+                }
+            }
+        }
+
+        void finish() override {
+            finished_ = true; // The read callback now reports end of stream once the input runs dry
+            if (!failed_ && !FLAC__stream_decoder_process_until_end_of_stream(decoder_)) {
+                reportFailure();
+            }
+            FLAC__stream_decoder_finish(decoder_);
+        }
+
+    private:
+        /// @brief Whether every metadata block is buffered, so reading them cannot run out of input
+        bool metadataBuffered() const {
+            if (input_.size() < 4) {
+                return false;
+            }
+            if (std::memcmp(input_.data(), "fLaC", 4) != 0) {
+                return input_.size() >= UNKNOWN_HEADER_BYTES; // E.g. an ID3 tag first: just buffer generously
+            }
+            size_t block = 4;
+            while (block + 4 <= input_.size()) {
+                const unsigned char* header = reinterpret_cast<const unsigned char*>(input_.data()) + block;
+                size_t length = (static_cast<size_t>(header[1]) << 16) | (static_cast<size_t>(header[2]) << 8) | header[3];
+                block += 4 + length;
+                if (header[0] & 0x80) { // Last metadata block
+                    return block + 4 <= input_.size(); // Plus the start of the first frame header
+                }
+            }
+            return false;
+        }
+
+        /// @brief Whether a whole frame is available to the decoder, counting what it has not consumed yet
+        bool frameBuffered() {
+            FLAC__uint64 decoded = 0;
+            size_t unconsumed = FLAC__stream_decoder_get_decode_position(decoder_, &decoded) ? static_cast<size_t>(handedOut_ - decoded) : 0;
+            return unconsumed + (input_.size() - position_) >= (maxFrameBytes_ > 0 ? maxFrameBytes_ : UNKNOWN_HEADER_BYTES);
+        }
+
+        /// @brief Log why libFLAC stopped; the rest of the response is ignored
+        void reportFailure() {
+            failed_ = true;
+            OPENAI_LOG_ERROR("flac_decode_error", "%s", FLAC__stream_decoder_get_resolved_state_string(decoder_));
+        }
+
+        static FLAC__StreamDecoderReadStatus readCallback(const FLAC__StreamDecoder*, FLAC__byte buffer[], size_t* bytes, void* clientData) {
+            FlacDecoder* self = static_cast<FlacDecoder*>(clientData);
+            size_t n = std::min(*bytes, self->input_.size() - self->position_);
+            if (n == 0) {
+                *bytes = 0;
+                if (self->finished_) {
+                    return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+                }
+                OPENAI_LOG_WARN("flac_frame_too_large", "FLAC frame larger than STREAMINFO allows");
+                return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+            }
+            std::memcpy(buffer, self->input_.data() + self->position_, n);
+            self->position_ += n;
+            self->handedOut_ += n;
+            *bytes = n;
+            return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+        }
+
+        static FLAC__StreamDecoderTellStatus tellCallback(const FLAC__StreamDecoder*, FLAC__uint64* offset, void* clientData) {
+            *offset = static_cast<FlacDecoder*>(clientData)->handedOut_;
+            return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+        }
+
+        static void metadataCallback(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* clientData) {
+            if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) {
+                return;
+            }
+            FlacDecoder* self = static_cast<FlacDecoder*>(clientData);
+            const FLAC__StreamMetadata_StreamInfo& info = metadata->data.stream_info;
+            self->setStreamFormat(static_cast<int>(info.sample_rate), static_cast<int>(info.channels));
+            // 0 means unknown: bound it by a verbatim frame (side channels carry one extra bit) plus headers
+            self->maxFrameBytes_ = info.max_framesize > 0 ? info.max_framesize
+                : static_cast<size_t>(info.max_blocksize) * info.channels * (info.bits_per_sample + 1) / 8 + FRAME_OVERHEAD_BYTES;
+        }
+
+        static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder*, const FLAC__Frame* frame, const FLAC__int32* const channels[], void* clientData) {
+            FlacDecoder* self = static_cast<FlacDecoder*>(clientData);
+            const unsigned streamChannels = frame->header.channels;
+            const size_t frames = frame->header.blocksize;
+            const float scale = 1.0f / static_cast<float>(1u << (frame->header.bits_per_sample - 1));
+            self->setStreamFormat(static_cast<int>(frame->header.sample_rate), static_cast<int>(streamChannels));
+
+            self->scratch_.resize(std::max(self->scratch_.size(), frames * std::max<size_t>(streamChannels, CHANNELS)));
+            float* pcm = self->scratch_.data();
+            for (size_t i = 0; i < frames; ++i) {
+                for (unsigned c = 0; c < streamChannels; ++c) {
+                    pcm[i * streamChannels + c] = channels[c][i] * scale;
+                }
+            }
+            self->output(pcm, frames);
+            return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+        }
+
+        static void errorCallback(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus status, void* clientData) {
+            static_cast<FlacDecoder*>(clientData)->stats_.corruptPackets += 1;
+            OPENAI_LOG_WARN("flac_stream_error", "%s", FLAC__StreamDecoderErrorStatusString[status]);
+        }
+
+        static constexpr size_t UNKNOWN_HEADER_BYTES = 65536; ///< Input buffered before decoding when sizes are unknown
+        static constexpr size_t FRAME_OVERHEAD_BYTES = 64; ///< Frame and subframe headers and CRC
+
+        FLAC__StreamDecoder* decoder_;
+        std::vector<char> input_; ///< Received bytes; those before position_ have been handed to libFLAC
+        size_t position_{ 0 };
+        FLAC__uint64 handedOut_{ 0 }; ///< Bytes handed to libFLAC since the response started
+        size_t maxFrameBytes_{ 0 }; ///< Largest possible frame, from STREAMINFO
+        bool metadataDone_{ false };
+        bool finished_{ false }; ///< The whole response has been received
+        bool failed_{ false }; ///< libFLAC gave up on this response
+        std::vector<float> scratch_; ///< Interleaved samples of the frame being written, grown to the largest block
+    };
+
+    /**
+    * @brief Raw PCM ("pcm") decoder: 24 kHz 16-bit little-endian mono unless a WAV header says otherwise
+    *
+    * Samples split across network chunks are carried over to the next one, and conversion runs in
+    * fixed blocks through a scratch buffer allocated once.
+    */
+    class PcmDecoder : public StreamDecoder {
+    public:
+        PcmDecoder(AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter)
+            : StreamDecoder(buffer, stats, jitter) {}
+
+        AudioFormat format() const override { return AudioFormat::Pcm; }
+
+        void start() override {
+            setLayout(SAMPLE_RATE, 1, 16, false);
+            carry_.clear();
+        }
+
+        void decode(const char* data, size_t size) override {
+            decodeSamples(reinterpret_cast<const unsigned char*>(data), size);
+        }
+
+        Json toJson() const override {
+            Json json = StreamDecoder::toJson();
+            json["bits_per_sample"] = bitsPerSample_;
+            json["float"] = isFloat_;
+            return json;
+        }
+
+    protected:
+        /// @return false if samples of this layout cannot be converted
+        bool setLayout(int sampleRate, int channels, int bitsPerSample, bool isFloat) {
+            if (channels <= 0 || (isFloat ? bitsPerSample != 32 : bitsPerSample % 8 != 0 || bitsPerSample < 8 || bitsPerSample > 32)) {
+                return false;
+            }
+            setStreamFormat(sampleRate, channels);
+            bitsPerSample_ = bitsPerSample;
+            isFloat_ = isFloat;
+            frameBytes_ = static_cast<size_t>(channels) * (bitsPerSample / 8);
+            scratch_.resize(BLOCK_FRAMES * std::max(channels, CHANNELS));
+            return true;
+        }
+
+        /// @brief Convert interleaved samples in the current layout, carrying a trailing partial frame over
+        void decodeSamples(const unsigned char* data, size_t size) {
+            if (!carry_.empty()) {
+                size_t n = std::min(size, frameBytes_ - carry_.size());
+                carry_.insert(carry_.end(), data, data + n);
+                data += n;
+                size -= n;
+                if (carry_.size() < frameBytes_) {
+                    return;
+                }
+                convert(carry_.data(), 1);
+                carry_.clear();
+            }
+
+            size_t frames = size / frameBytes_;
+            for (size_t done = 0; done < frames;) {
+                size_t n = std::min(BLOCK_FRAMES, frames - done);
+                convert(data + done * frameBytes_, n);
+                done += n;
+            }
+            carry_.assign(data + frames * frameBytes_, data + size);
+        }
+
+    private:
+        /// @brief Convert `frames` whole frames and append them to the buffer
+        void convert(const unsigned char* data, size_t frames) {
+            const size_t samples = frames * channels_;
+            const int bytes = bitsPerSample_ / 8;
+            float* pcm = scratch_.data();
+            for (size_t i = 0; i < samples; ++i, data += bytes) {
+                if (isFloat_) {
+                    std::memcpy(&pcm[i], data, sizeof(float)); // Little-endian hosts only, like the rest of the pipeline
+                }
+                else if (bytes == 1) {
+                    pcm[i] = (data[0] - 128) / 128.0f; // 8-bit WAV samples are unsigned
+                }
+                else {
+                    // Sign-extend the little-endian value from the top byte down
+                    int32_t value = static_cast<int8_t>(data[bytes - 1]);
+                    for (int b = bytes - 2; b >= 0; --b) {
+                        value = value * 256 + data[b];
+                    }
+                    pcm[i] = static_cast<float>(value) / static_cast<float>(1u << (bitsPerSample_ - 1));
+                }
+            }
+            output(pcm, frames);
+        }
+
+        static constexpr size_t BLOCK_FRAMES = 1024; ///< Frames converted per write to the buffer
+
+        int bitsPerSample_{ 16 };
+        bool isFloat_{ false };
+        size_t frameBytes_{ 2 }; ///< Bytes per interleaved frame
+        std::vector<unsigned char> carry_; ///< Partial frame left by the previous chunk
+        std::vector<float> scratch_;
+    };
+
+    /**
+    * @brief WAV ("wav") decoder: parses the RIFF header, then converts the data chunk as raw PCM
+    *
+    * Streamed WAV files often carry a placeholder data size, so a size of 0 or 0xFFFFFFFF means the
+    * data runs to the end of the response.
+    */
+    class WavDecoder : public PcmDecoder {
+    public:
+        using PcmDecoder::PcmDecoder;
+
+        AudioFormat format() const override { return AudioFormat::Wav; }
+
+        void start() override {
+            PcmDecoder::start();
+            header_.clear();
+            state_ = State::Header;
+            dataRemaining_ = 0;
+        }
+
+        void decode(const char* data, size_t size) override {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            if (state_ == State::Header) {
+                header_.insert(header_.end(), bytes, bytes + size);
+                size_t dataStart = 0;
+                if (!parseHeader(dataStart)) {
+                    return;
+                }
+                if (state_ == State::Data) {
+                    std::vector<unsigned char> rest(header_.begin() + dataStart, header_.end());
+                    header_.clear();
+                    decodeData(rest.data(), rest.size());
+                }
+                return;
+            }
+            if (state_ == State::Data) {
+                decodeData(bytes, size);
+            }
+        }
+
+    private:
+        enum class State { Header, Data, Invalid };
+
+        void decodeData(const unsigned char* data, size_t size) {
+            size_t n = std::min<uint64_t>(size, dataRemaining_);
+            dataRemaining_ -= n;
+            decodeSamples(data, n);
+        }
+
+        /// @brief Walk the chunks buffered so far up to the start of the data chunk
+        /// @return false while more header bytes are needed
+        bool parseHeader(size_t& dataStart) {
+            auto u16 = [this](size_t at) { return static_cast<uint32_t>(header_[at] | (header_[at + 1] << 8)); };
+            auto u32 = [this, &u16](size_t at) { return u16(at) | (u16(at + 2) << 16); };
+
+            if (header_.size() < 12) {
+                return false;
+            }
+            if (std::memcmp(header_.data(), "RIFF", 4) != 0 || std::memcmp(header_.data() + 8, "WAVE", 4) != 0) {
+                OPENAI_LOG_ERROR("invalid_wav_header", "WAV stream does not start with a RIFF/WAVE header");
+                state_ = State::Invalid;
+                return true;
+            }
+
+            bool haveFormat = false;
+            size_t chunk = 12;
+            while (chunk + 8 <= header_.size()) {
+                uint32_t length = u32(chunk + 4);
+                if (std::memcmp(header_.data() + chunk, "data", 4) == 0) {
+                    if (!haveFormat) {
+                        OPENAI_LOG_ERROR("invalid_wav_header", "WAV data chunk precedes its fmt chunk");
+                        state_ = State::Invalid;
+                        return true;
+                    }
+                    dataRemaining_ = length == 0 || length == 0xFFFFFFFF ? UINT64_MAX : length;
+                    dataStart = chunk + 8;
+                    state_ = State::Data;
+                    return true;
+                }
+                if (chunk + 8 + length > header_.size()) {
+                    return false;
+                }
+                if (std::memcmp(header_.data() + chunk, "fmt ", 4) == 0 && length >= 16) {
+                    uint32_t tag = u16(chunk + 8);
+                    if (tag == WAVE_FORMAT_EXTENSIBLE && length >= 26) {
+                        tag = u16(chunk + 8 + 24); // First two bytes of the SubFormat GUID
+                    }
+                    int channels = static_cast<int>(u16(chunk + 10));
+                    int sampleRate = static_cast<int>(u32(chunk + 12));
+                    int bitsPerSample = static_cast<int>(u16(chunk + 22));
+                    if ((tag != WAVE_FORMAT_PCM && tag != WAVE_FORMAT_IEEE_FLOAT)
+                        || !setLayout(sampleRate, channels, bitsPerSample, tag == WAVE_FORMAT_IEEE_FLOAT)) {
+                        OPENAI_LOG_ERROR("unsupported_wav_format", "Format %u with %d bits per sample", static_cast<unsigned>(tag), bitsPerSample);
+                        state_ = State::Invalid;
+                        return true;
+                    }
+                    haveFormat = true;
+                }
+                chunk += 8 + length + (length & 1); // Chunks are padded to an even length
             }
-            return i; // Number of frames read
+            return false;
         }
 
-        bool isEmpty() const {
-            return buffer.empty();
-        }
+        static constexpr uint32_t WAVE_FORMAT_PCM = 1;
+        static constexpr uint32_t WAVE_FORMAT_IEEE_FLOAT = 3;
+        static constexpr uint32_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+        State state_{ State::Header };
+        std::vector<unsigned char> header_; ///< Bytes received before the data chunk
+        uint64_t dataRemaining_{ 0 }; ///< Bytes of the data chunk not yet received
     };
 
+    /// @brief Create the decoder for `format`
+    /// @throws std::invalid_argument if no decoder exists for it (see canDecode)
+    inline std::unique_ptr<StreamDecoder> createStreamDecoder(AudioFormat format, AudioBuffer& buffer, PipelineStats& stats, JitterBuffer& jitter) {
+        switch (format) {
+        case AudioFormat::Opus: return std::make_unique<OggOpusDecoder>(buffer, stats, jitter);
+        case AudioFormat::Mp3: return std::make_unique<Mp3Decoder>(buffer, stats, jitter);
+        case AudioFormat::Flac: return std::make_unique<FlacDecoder>(buffer, stats, jitter);
+        case AudioFormat::Wav: return std::make_unique<WavDecoder>(buffer, stats, jitter);
+        case AudioFormat::Pcm: return std::make_unique<PcmDecoder>(buffer, stats, jitter);
+        case AudioFormat::Aac: break;
+        }
+        throw std::invalid_argument(std::string("No decoder for response_format ") + audioFormatToString(format));
+    }
+
     struct SharedData {
         FILE* file;
-        std::atomic<bool> dataReady;
+        std::unique_ptr<ArchiveWriter> archive; // Writes the raw response stream to `file` in the background
         AudioBuffer audioBuffer;
 
-        ogg_sync_state oy;          // Ogg sync state, for syncing with the Ogg stream
-        ogg_stream_state os;        // Ogg stream state, for handling logical streams
-        ogg_page og;                // Ogg page, a single unit of data in an Ogg stream
-        ogg_packet op;              // Ogg packet, contains encoded Opus data
-        OpusDecoder* opusDecoder;   // Opus decoder state
-        int opusError;              // Error code returned by Opus functions
-        bool oggInitialized;        // Flag to track if Ogg and Opus have been initialized
-        int serial_number;          // Serial number for the Ogg stream
+        ChunkQueue chunks;          // Compressed chunks waiting for the decode worker
+        std::thread decodeThread;   // Decode worker, running while a response is streaming
+        std::unique_ptr<StreamDecoder> decoder; // Decoder for the response format of the current response
+        std::atomic<bool> decoderDone{ false }; // Set once the worker has decoded the whole response
+        std::atomic<bool> responseStarted{ false }; // A response has been started; before that only clips can play
+        PipelineStats stats;        // Per-stage queue depths and timings
+
+        std::atomic<const PcmClip*> nextClip{ nullptr }; // Clip handed to the audio callback by playClip()
+        const PcmClip* currentClip = nullptr;             // Clip being played (audio callback only)
+        size_t clipPosition = 0;                          // Samples of currentClip already played (audio callback only)
+
+        PlaybackStats playback;                           // Underrun accounting of the audio callback
+        JitterBuffer jitter;                              // When the audio callback starts and resumes playback
+        std::atomic<bool> stopWhenDrained{ false };       // Complete the stream once the response has been played
+
+        std::atomic<bool> interrupted{ false };           // The current response was interrupted; drop the rest of it
+        std::atomic<bool> fadeOutRequested{ false };      // The audio callback should fade out and flush (set by interrupt())
 
         // Constructor
-        SharedData(FILE* file) : file(file), dataReady(false), opusDecoder(nullptr), opusError(OPUS_OK), oggInitialized(false), serial_number(-1) {
-            // Initialize the Ogg sync state
-            ogg_sync_init(&oy);
-        }
+        SharedData(FILE* file, size_t bufferCapacity = AUDIO_BUFFER_CAPACITY,
+            ArchiveWriter::Options archiveOptions = ArchiveWriter::Options{})
+            : file(file), archive(file ? std::make_unique<ArchiveWriter>(file, archiveOptions) : nullptr), audioBuffer(bufferCapacity) {}
 
         // Destructor
         ~SharedData() {
+            setCancellationToken(nullptr);
             cleanup();
         }
 
-        void initOpusDecoder() {
-            if (!opusDecoder) {
-                opusDecoder = opus_decoder_create(SAMPLE_RATE, CHANNELS, &opusError);
-                if (opusError != OPUS_OK) {
-                    throw std::runtime_error("Failed to create Opus decoder: " + std::string(opus_strerror(opusError)));
+        /// @brief Interrupt the stream whenever `token` is cancelled; nullptr detaches the current token
+        void setCancellationToken(std::shared_ptr<CancellationToken> token) {
+            if (cancellation_) {
+                cancellation_->removeListener(cancellationId_);
+            }
+            cancellation_ = std::move(token);
+            cancellationId_ = cancellation_ ? cancellation_->addListener([this] { interrupt(); }) : 0;
+        }
+
+        /// @brief Remember the transfer feeding the current response, so interrupt() can abort it
+        void setTransfer(RequestHandle transfer) {
+            std::lock_guard<std::mutex> lock(transferMutex_);
+            transfer_ = std::move(transfer);
+            if (interrupted && transfer_) {
+                transfer_->cancel();
+            }
+        }
+
+        /// @brief Stop the current response at every stage (any thread; barge-in)
+        ///
+        /// The transfer is aborted, queued chunks are dropped and the worker stops decoding. The audio
+        /// callback fades out what it is playing within its next period and flushes the ring buffer.
+        void interrupt() {
+            if (interrupted.exchange(true)) {
+                return;
+            }
+            stats.markOnce(stats.interruptNanos);
+            {
+                std::lock_guard<std::mutex> lock(transferMutex_);
+                if (transfer_) {
+                    transfer_->cancel();
                 }
             }
+            chunks.clear();
+            chunks.close();
+            audioBuffer.requestFlush();
+            fadeOutRequested.store(true, std::memory_order_release);
         }
 
-        void cleanup() {
-            if (opusDecoder) {
-                opus_decoder_destroy(opusDecoder);
-                opusDecoder = nullptr;
+        /// @brief Start the decode worker for a new response in `format`
+        /// @throws std::invalid_argument if there is no decoder for `format`
+        void startDecoder(AudioFormat format = AudioFormat::Opus) {
+            stopDecoder();
+            if (!decoder || decoder->format() != format) {
+                decoder = createStreamDecoder(format, audioBuffer, stats, jitter);
             }
-            if (oggInitialized) {
-                ogg_stream_clear(&os);
-                ogg_sync_clear(&oy);
-                oggInitialized = false;
+            beginResponse();
+            decoder->start();
+            decodeThread = std::thread([this] { decodeLoop(); });
+        }
+
+        /// @brief Reset the per-response state (stats, jitter buffer, interruption, decoderDone) for a new
+        /// response; startDecoder() does this, writers filling the buffer without a decoder call it directly
+        void beginResponse() {
+            stats.reset();
+            jitter.startStream();
+            setTransfer(nullptr);
+            interrupted = false;
+            fadeOutRequested.store(false, std::memory_order_release); // Left over from an interrupted previous response
+            decoderDone = false;
+            responseStarted = true;
+            chunks.reopen();
+            // The token only notifies its listeners once, so a barge-in that came before or while this
+            // response was starting would otherwise be forgotten
+            if (cancellation_ && cancellation_->isCancelled()) {
+                interrupt();
             }
         }
 
-        // Initialize the Ogg stream state; should be called when a new stream is detected
-        void initOggStream(int serial) {
-            if (ogg_stream_init(&os, serial) != 0) {
-                throw std::runtime_error("Failed to initialize Ogg stream state.");
+        /// @brief Signal end of stream and wait for the decode worker to drain the queue
+        void stopDecoder() {
+            chunks.close();
+            if (decodeThread.joinable()) {
+                decodeThread.join();
             }
-            serial_number = serial;
-            oggInitialized = true;
         }
 
-        // Reset the Ogg stream state; should be called for a new logical stream
-        void resetOggStream() {
-            if (oggInitialized) {
-                ogg_stream_clear(&os);
+        /// @brief Play a pre-decoded clip next, ahead of any streamed audio; the clip must outlive playback
+        void playClip(const PcmClip* clip) {
+            nextClip.store(clip, std::memory_order_release);
+            if (!responseStarted) {
+                decoderDone = true; // Clip-only playback: nothing else will arrive, so playAudio() can end after the clip
+            }
+        }
+
+        /// @brief Tell the decode worker that the response is complete (network thread)
+        void endOfStream() {
+            chunks.close();
+        }
+
+        /// @brief Hand a received chunk to the decode worker (network thread)
+        void pushChunk(const char* data, size_t size) {
+            auto begin = PipelineStats::Clock::now();
+            stats.markOnce(stats.firstByteNanos);
+            size_t depth = chunks.push(std::vector<char>(data, data + size));
+            stats.updateMaxQueueDepth(depth);
+            stats.chunksReceived += 1;
+            stats.bytesReceived += size;
+            stats.receiveNanos += PipelineStats::nanosBetween(begin, PipelineStats::Clock::now());
+        }
+
+        void cleanup() {
+            stopDecoder();
+            decoder.reset();
+            closeArchive();
+        }
+
+        /// @brief Write out and sync the archive; call before closing `file`
+        void closeArchive() {
+            if (archive) {
+                archive->close();
             }
-            if (serial_number != -1) {
-                initOggStream(serial_number);
+        }
+
+    private:
+        /// @brief Worker loop: decode queued chunks into the audio buffer, then archive them
+        void decodeLoop() {
+            std::vector<char> chunk;
+            bool failed = false; // The decoder threw; the rest of the response is dropped
+            while (chunks.pop(chunk)) {
+                if (interrupted || failed) {
+                    continue; // Drain without decoding
+                }
+                auto begin = PipelineStats::Clock::now();
+                failed = !decodeSafely([&] { decoder->decode(chunk.data(), chunk.size()); });
+                auto decoded = PipelineStats::Clock::now();
+                stats.decodeNanos += PipelineStats::nanosBetween(begin, decoded);
+
+                if (archive) {
+                    archive->write(std::move(chunk));
+                    stats.archiveNanos += PipelineStats::nanosBetween(decoded, PipelineStats::Clock::now());
+                }
+            }
+            if (archive) {
+                archive->flush();
+            }
+
+            if (interrupted) {
+                audioBuffer.requestFlush(); // Also drop whatever was decoded after interrupt() ran
             }
+            else if (!failed) {
+                auto begin = PipelineStats::Clock::now();
+                decodeSafely([&] { decoder->finish(); });
+                stats.decodeNanos += PipelineStats::nanosBetween(begin, PipelineStats::Clock::now());
+            }
+            decoderDone = true;
+        }
+
+        /// @brief Run a decoder call on the worker thread, where an exception would terminate the process
+        /// @return false if the decoder threw; the response is counted as a corrupt stream
+        template <typename Call>
+        bool decodeSafely(Call&& call) {
+            try {
+                call();
+                return true;
+            }
+            catch (const std::exception& e) {
+                OPENAI_LOG_ERROR("decode_failed", "%s", e.what());
+            }
+            catch (...) {
+                OPENAI_LOG_ERROR("decode_failed", "Unknown exception");
+            }
+            stats.corruptStreams += 1;
+            return false;
         }
+
+        std::shared_ptr<CancellationToken> cancellation_; // Token whose cancellation interrupts the stream
+        size_t cancellationId_ = 0;                      // Listener registered on cancellation_
+        std::mutex transferMutex_;                       // Protects transfer_
+        RequestHandle transfer_;                         // Transfer feeding the current response, if any
     };
 
 
@@ -131,256 +1802,314 @@ namespace openai {
         PaStreamCallbackFlags statusFlags,
         void* userData) {
         SharedData* sharedData = static_cast<SharedData*>(userData);
+        PlaybackStats& playback = sharedData->playback;
+        playback.callbacks.fetch_add(1, std::memory_order_relaxed);
 
         float* out = static_cast<float*>(outputBuffer);
         std::fill(out, out + framesPerBuffer * CHANNELS, 0.0f); // Fill buffer with silence
 
-        if (!sharedData->dataReady) {
-            // No data available yet, just play silence
+        // Interrupted: fade out whatever was about to play, then drop the rest of the response
+        if (sharedData->fadeOutRequested.exchange(false, std::memory_order_acq_rel)) {
+            size_t n = std::min<size_t>(framesPerBuffer * CHANNELS, JitterBuffer::FADE_SAMPLES);
+            if (const PcmClip* clip = sharedData->currentClip) {
+                n = std::min(n, clip->count - sharedData->clipPosition);
+                std::copy(clip->samples + sharedData->clipPosition, clip->samples + sharedData->clipPosition + n, out);
+                sharedData->currentClip = nullptr;
+            }
+            else {
+                n = sharedData->jitter.playing() ? sharedData->audioBuffer.getData(out, n) : 0;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                out[i] *= static_cast<float>(n - 1 - i) / n;
+            }
+            sharedData->jitter.onDrained();
+            playback.flushedSamples.fetch_add(sharedData->audioBuffer.applyFlush(), std::memory_order_relaxed);
+            playback.interruptions.fetch_add(1, std::memory_order_relaxed);
+            playback.samplesPlayed.fetch_add(n, std::memory_order_relaxed);
+            sharedData->stats.markOnce(sharedData->stats.silencedNanos);
+            return paContinue;
+        }
+        playback.flushedSamples.fetch_add(sharedData->audioBuffer.applyFlush(), std::memory_order_relaxed);
+
+        // Pre-decoded clips are read straight from their (memory-mapped) storage and take priority
+        if (const PcmClip* clip = sharedData->nextClip.exchange(nullptr, std::memory_order_acquire)) {
+            sharedData->currentClip = clip;
+            sharedData->clipPosition = 0;
+        }
+        if (const PcmClip* clip = sharedData->currentClip) {
+            size_t n = std::min<size_t>(framesPerBuffer * CHANNELS, clip->count - sharedData->clipPosition);
+            std::copy(clip->samples + sharedData->clipPosition, clip->samples + sharedData->clipPosition + n, out);
+            sharedData->clipPosition += n;
+            playback.samplesPlayed.fetch_add(n, std::memory_order_relaxed);
+            if (sharedData->clipPosition >= clip->count) {
+                sharedData->currentClip = nullptr;
+            }
+            return paContinue;
+        }
+
+        // Read decoderDone before the buffer size so no sample written before it is mistaken for missing
+        JitterBuffer& jitter = sharedData->jitter;
+        const size_t needed = framesPerBuffer * CHANNELS;
+        bool decoded = sharedData->decoderDone;
+        size_t available = sharedData->audioBuffer.size();
+
+        if (decoded && available == 0) {
+            jitter.onDrained();
+            // A clip queued together with decoderDone may have been missed by the exchange above
+            if (sharedData->stopWhenDrained && !sharedData->nextClip.load(std::memory_order_acquire)) {
+                return paComplete;
+            }
+            playback.silentCallbacks.fetch_add(1, std::memory_order_relaxed);
             return paContinue;
         }
 
-        size_t bytesRead = sharedData->audioBuffer.getData(out, framesPerBuffer * CHANNELS);
-        if (bytesRead < framesPerBuffer * CHANNELS) {
-            // Buffer underflow, not enough data available
-            sharedData->dataReady = false; // Wait for more data
+        if (!jitter.playing()) {
+            // Prebuffer: play silence until enough audio is queued to ride out the network jitter
+            if (!jitter.ready(available, needed, decoded)) {
+                playback.silentCallbacks.fetch_add(1, std::memory_order_relaxed);
+                return paContinue;
+            }
+            jitter.onStart();
+        }
+
+        // While streaming, hold back a fade's worth of samples so an underrun can be faded out
+        size_t holdBack = decoded ? 0 : JitterBuffer::FADE_SAMPLES;
+        size_t samplesRead = sharedData->audioBuffer.getData(out, available > holdBack ? std::min(needed, available - holdBack) : 0);
+        if (samplesRead < needed && !decoded) {
+            // Underrun: play the held-back tail fading to silence, then rebuffer
+            samplesRead += sharedData->audioBuffer.getData(out + samplesRead, std::min(needed - samplesRead, JitterBuffer::FADE_SAMPLES));
+            size_t fadeStart = samplesRead > JitterBuffer::FADE_SAMPLES ? samplesRead - JitterBuffer::FADE_SAMPLES : 0;
+            for (size_t i = fadeStart; i < samplesRead; ++i) {
+                out[i] *= static_cast<float>(samplesRead - 1 - i) / (samplesRead - fadeStart);
+            }
+            jitter.onUnderrun();
+            playback.underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            jitter.onPlayed(out, samplesRead);
+        }
+
+        playback.samplesPlayed.fetch_add(samplesRead, std::memory_order_relaxed);
+        if (samplesRead > 0) {
+            sharedData->stats.markOnce(sharedData->stats.firstAudioNanos);
+            if (decoded && sharedData->audioBuffer.isEmpty()) {
+                sharedData->stats.markOnce(sharedData->stats.lastAudioNanos);
+            }
         }
 
         return paContinue;
     }
 
-    // Function to play an audio file using libsndfile and PortAudio
+    /// @brief Play `shared_data` on `sink` until the stream has been fully played or the sink is stopped
+    /// @return false if the sink could not be started
+    bool playAudio(SharedData* shared_data, AudioSink& sink) {
+        shared_data->stopWhenDrained = true;
+        if (!sink.start(StreamFormat{ CHANNELS, SAMPLE_RATE, FRAMES_PER_BUFFER }, audioCallback, shared_data)) {
+            return false;
+        }
+        sink.waitUntilDone();
+        sink.stop();
+        LatencyRecorder::instance().record(shared_data->stats.latency());
+        return true;
+    }
+
+    // Function to play the streamed audio on the default output device
     void playAudio(SharedData* shared_data) {
-        // Initialize PortAudio
-        PaStream* stream = nullptr;
-        PaError err = Pa_Initialize();
-        if (err != paNoError) {
-            std::cerr << "PortAudio initialization error: " << Pa_GetErrorText(err) << std::endl;
-            return;
-        }
-
-        // Open PortAudio stream
-        err = Pa_OpenDefaultStream(&stream, 0, CHANNELS, paFloat32, SAMPLE_RATE, FRAMES_PER_BUFFER, audioCallback, shared_data);
-        if (err != paNoError) {
-            std::cerr << "PortAudio stream open error: " << Pa_GetErrorText(err) << std::endl;
-            Pa_Terminate();
-            return;
-        }
-
-        // Start PortAudio stream for playback
-        err = Pa_StartStream(stream);
-        if (err != paNoError) {
-            std::cerr << "PortAudio stream start error: " << Pa_GetErrorText(err) << std::endl;
-            Pa_CloseStream(stream);
-            Pa_Terminate();
-            //sf_close(sndfile);
-            return;
-        }
-
-        // Wait for user input to stop playback (you can implement your own stop mechanism)
-        std::cout << "Press Enter to stop playback..." << std::endl;
-        std::cin.get();
-
-        // Stop and close PortAudio stream
-        err = Pa_StopStream(stream);
-        if (err != paNoError) {
-            std::cerr << "PortAudio stream stop error: " << Pa_GetErrorText(err) << std::endl;
-            // sf_close(sndfile);
-            Pa_Terminate();
-            return;
-        }
-
-        err = Pa_CloseStream(stream);
-        if (err != paNoError) {
-            std::cerr << "PortAudio stream close error: " << Pa_GetErrorText(err) << std::endl;
-            // sf_close(sndfile);
-            Pa_Terminate();
-            return;
-        }
-
-        // Terminate PortAudio and close the audio file
-        Pa_Terminate();
+        PortAudioSink sink;
+        playAudio(shared_data, sink);
     }
 
 
 
+    /// @brief Parameters of a speech request other than the input text
+    struct TtsOptions {
+        std::string model{ "tts-1-hd" }; ///< "tts-1" for the lowest latency, "tts-1-hd" for quality
+        std::string voice{ "alloy" };
+        AudioFormat format{ AudioFormat::Opus }; ///< Sent as response_format and used to pick the decoder
+        double speed{ 1.0 }; ///< 0.25 to 4.0
+        std::string instructions; ///< Speaking style, for models that accept it; omitted when empty
+    };
+
     /**
-    * @brief Class to handle the curl session
+    * @brief Speech request body serialized once, with only the input text spliced in per call
+    *
+    * Every option is written to JSON up front; build() appends the escaped text between the stored
+    * prefix and suffix, so a request body costs one string and no DOM. Templates are immutable, so one
+    * can be shared by any number of threads, and each call can pick its own (e.g. tts-1 for a quick
+    * acknowledgement and tts-1-hd for the answer that follows).
     */
-    class Session {
+    class TtsRequestTemplate {
     public:
-        /// @brief Construct a new Session object by initializing curl and setting the options
-        Session() {
-            // Initialize curl
-            curl_global_init(CURL_GLOBAL_ALL);// || CURL_VERSION_THREADSAFE);
-
-            curl_ = curl_easy_init();
-            if (curl_ == nullptr) {
-                std::cout << "OpenAI curl_easy_init() failed" << '\n';
+        /// @throws std::invalid_argument if there is no decoder for `options.format` (AAC)
+        explicit TtsRequestTemplate(TtsOptions options = {}) : options_{ std::move(options) } {
+            if (!canDecode(options_.format)) {
+                throw std::invalid_argument(std::string("No decoder for response_format ") + audioFormatToString(options_.format));
             }
-
-            // Ignore SSL
-            curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
+            Json json{
+                {"model", options_.model},
+                {"voice", options_.voice},
+                {"response_format", audioFormatToString(options_.format)},
+                {"speed", options_.speed}
+            };
+            if (!options_.instructions.empty()) {
+                json["instructions"] = options_.instructions;
+            }
+            prefix_ = json.dump();
+            prefix_.back() = ','; // Reopen the object for the input
+            prefix_ += "\"input\":\"";
         }
 
-        /// @brief Destroy the Session object by cleaning up curl
-        ~Session() {
-            curl_easy_cleanup(curl_);
-            curl_global_cleanup();
+        /// @brief Write the request body for `text` into `body`, reusing its capacity
+        void build(std::string_view text, std::string& body) const {
+            body.clear();
+            body.reserve(prefix_.size() + text.size() + text.size() / 8 + 2);
+            body += prefix_;
+            appendEscaped(text, body);
+            body += "\"}";
         }
 
-        /// @brief Set the url to make the request to
-        void setUrl(const std::string& url) { url_ = url; }
-
-        /// @brief Set the token to use for authentication
-        void setToken(const std::string& token) {
-            token_ = token;
+        std::string build(std::string_view text) const {
+            std::string body;
+            build(text, body);
+            return body;
         }
 
-        /// @brief Set the body of the request to send
-        void setBody(const std::string& data) {
-            if (curl_) {
-                curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, data.length());
-                curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, data.data());
+        const TtsOptions& options() const { return options_; }
+
+    private:
+        /// @brief Append `text` as the contents of a JSON string; UTF-8 passes through unchanged
+        static void appendEscaped(std::string_view text, std::string& out) {
+            static const char hex[] = "0123456789abcdef";
+            size_t plain = 0; // Start of the run of characters that need no escaping
+            for (size_t i = 0; i < text.size(); ++i) {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    continue;
+                }
+                out.append(text.data() + plain, i - plain);
+                plain = i + 1;
+                switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default:
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                }
             }
+            out.append(text.data() + plain, text.size() - plain);
         }
 
-        bool makeRequest(SharedData* sharedData) {
-            std::lock_guard<std::mutex> lock(mutex_request_); // Lock the request to avoid concurrent requests
-
-            // Set the headers
-            struct curl_slist* headers = NULL;
-            headers = curl_slist_append(headers, std::string{ "Authorization: Bearer " + token_ }.c_str());
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
-            curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
+        TtsOptions options_;
+        std::string prefix_; ///< Serialized options followed by `"input":"`
+    };
 
-            // Set the callback function to write binary data
-            curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, writeBinaryData);
-            curl_easy_setopt(curl_, CURLOPT_WRITEDATA, sharedData);
+    /**
+    * @brief Class to build OpenAI requests and hand them to the RequestEngine
+    *
+    * A Session holds no per-request state, so any number of chat and speech requests may be in flight
+    * on the same Session at once.
+    */
+    class Session {
+    public:
+        /// @brief Construct a new Session object; transfers run on the process-wide RequestEngine
+        Session() = default;
 
-            // Perform the request
-            res_ = curl_easy_perform(curl_);
+        /// @brief Set the token to use for authentication
+        void setToken(const std::string& token) {
+            token_ = token;
+        }
 
-            // Check for errors
-            if (res_ != CURLE_OK) {
-                std::string error_msg = "OpenAI curl_easy_perform() failed: " + std::string{ curl_easy_strerror(res_) } + '\n';
-                std::cout << error_msg << std::endl;
-                return false;
-            }
+        /// @brief Receives the complete response body of a binary request once it has finished
+        using ResponseCallback = std::function<void(std::string&& response, CURLcode result, long httpStatus)>;
+
+        /// @brief Start a request whose binary (audio) response is fed to the decoder of `sharedData`
+        /// @param onResponse Optional consumer of the whole response body (e.g. to cache it)
+        /// @return Handle to wait on or cancel the transfer
+        RequestHandle submitRequest(const std::string& url, const std::string& body, SharedData* sharedData,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }, ResponseCallback onResponse = nullptr) {
+            Request request = buildRequest(url, body, timeout);
+            auto response = onResponse ? std::make_shared<std::string>() : nullptr;
+            request.onData = [sharedData, response](const char* data, size_t size) {
+                if (sharedData->interrupted) {
+                    return false; // Abort the transfer
+                }
+                if (response) {
+                    response->append(data, size);
+                }
+                return writeBinaryData(data, size, sharedData) == size;
+            };
+            request.onStart = [sharedData] {
+                sharedData->stats.markOnce(sharedData->stats.requestSentNanos);
+            };
+            request.onComplete = [sharedData, response, onResponse](CURLcode result, long httpStatus) {
+                sharedData->endOfStream();
+                if (onResponse) {
+                    onResponse(std::move(*response), result, httpStatus);
+                }
+            };
+            return RequestEngine::instance().submit(std::move(request));
+        }
 
-            // Clean up the headers
-            curl_slist_free_all(headers);
+        /// @brief Start a streaming request whose server-sent events are fed to `message`
+        /// @return Handle to wait on or cancel the transfer
+        RequestHandle submitStreamRequest(const std::string& url, const std::string& body, Message* message,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }) {
+            Request request = buildRequest(url, body, timeout);
+            request.onData = [message](const char* data, size_t size) {
+                return writeStreamFunction(data, size, message) == size;
+            };
+            return RequestEngine::instance().submit(std::move(request));
+        }
 
-            return true;
+        /// @brief Make the request and wait for it to finish
+        /// @return true if the request was successful
+        bool makeRequest(const std::string& url, const std::string& body, SharedData* sharedData) {
+            return submitRequest(url, body, sharedData)->wait();
         }
 
         /// @brief Make the request and return whether it was successful
         /// @return true if the request was successful
-        bool makeStreamRequest(Message* message) {
-            std::lock_guard<std::mutex> lock(mutex_request_); // Lock the request to avoid concurrent requests
-
-            // Set the headers
-            struct curl_slist* headers = NULL;
-            headers = curl_slist_append(headers, std::string{ "Authorization: Bearer " + token_ }.c_str());
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
-            curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
-
-            // Set the callback function
-            std::string header_string;
-            curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, writeStreamFunction);
-            curl_easy_setopt(curl_, CURLOPT_WRITEDATA, message);
-            curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &header_string);
-
-            // Perform the request
-            res_ = curl_easy_perform(curl_);
-
-            // Check for errors
-            if (res_ != CURLE_OK) {
-                std::string error_msg = "OpenAI curl_easy_perform() failed: " + std::string{ curl_easy_strerror(res_) } + '\n';
-                std::cout << error_msg << std::endl;
-                return false;
-            }
-            return true;
+        bool makeStreamRequest(const std::string& url, const std::string& body, Message* message) {
+            return submitStreamRequest(url, body, message)->wait();
         };
 
     private:
-        /// @brief Callback function to write the audio response to the file
-        static size_t writeBinaryData(void* ptr, size_t size, size_t nmemb, void* stream) {
-            // Print the first few bytes of the incoming Opus data
-            std::cout << "Incoming Opus data (" << size * nmemb << " bytes): ";
-            for (size_t i = 0; i < 16; ++i) {
-                std::printf("%02X ", static_cast<unsigned char*>(ptr)[i]);
-            }
-            std::cout << "...\n";
-
-
-            SharedData* sharedData = static_cast<SharedData*>(stream);
-
-            // Buffer to store the incoming Ogg data
-            char* buffer = ogg_sync_buffer(&sharedData->oy, size * nmemb);
-            memcpy(buffer, ptr, size * nmemb);
-            ogg_sync_wrote(&sharedData->oy, size * nmemb);
-
-            // Process the Ogg pages and extract Opus packets
-            while (ogg_sync_pageout(&sharedData->oy, &sharedData->og) == 1) {
-                if (!sharedData->oggInitialized || sharedData->serial_number == -1) {
-                    sharedData->serial_number = ogg_page_serialno(&sharedData->og);
-                    sharedData->initOggStream(sharedData->serial_number);
-                }
-
-                if (ogg_stream_pagein(&sharedData->os, &sharedData->og) != 0) {
-                    std::cerr << "Failed to read Ogg page into stream." << std::endl;
-                }
-
-                ogg_packet op;
-                while (ogg_stream_packetout(&sharedData->os, &op) == 1) {
-                    // Decode the Opus packet
-                    float decodedPCM[FRAMES_PER_BUFFER * CHANNELS];
-                    int frameSize = opus_decode_float(sharedData->opusDecoder, op.packet, op.bytes, decodedPCM, FRAMES_PER_BUFFER, 0);
-                    if (frameSize < 0) {
-                        // Handle Opus decoding error
-                        std::cerr << "Opus decoding error: " << opus_strerror(frameSize) << std::endl;
-                        continue;
-                    }
-
-                    sharedData->audioBuffer.addData(decodedPCM, frameSize * CHANNELS);
-                    sharedData->dataReady = true;
-                }
-            }
-
-            // Debugging output
-            std::cout << "Received Ogg Opus data (" << size * nmemb << " bytes)." << std::endl;
-
-
-            size_t written = fwrite(ptr, size, nmemb, sharedData->file);
-            std::cout << "Written: " << written << std::endl;
+        Request buildRequest(const std::string& url, const std::string& body, std::chrono::milliseconds timeout) const {
+            Request request;
+            request.url = url;
+            request.body = body;
+            request.timeout = timeout;
+            request.headers.push_back("Authorization: Bearer " + token_);
+            request.headers.push_back("Content-Type: application/json");
+            return request;
+        }
 
-            return size * nmemb;
+        /// @brief Callback function to hand the audio response to the decode worker
+        static size_t writeBinaryData(const char* ptr, size_t size, SharedData* sharedData) {
+            OPENAI_LOG_TRACE("audio_received", "%zu bytes", size);
+            // Only queue the raw bytes here; demuxing, decoding and archiving happen on the decode worker
+            sharedData->pushChunk(ptr, size);
+            return size;
         }
 
 
         /// @brief Callback function to write the response to our StreamResponse object
-        static size_t writeStreamFunction(void* ptr, size_t size, size_t nmemb, Message* msg) {
-            size_t realsize = size * nmemb;
-            std::string text((char*)ptr, realsize);
-#if DEBUG
-            std::cout << "Write stream message type: " + messageTypeToString(msg->getType()) << std::endl;
-            std::cout << "Write stream text: " + text << std::endl;
-#endif
-            msg->setAIResponse(text);
-            return size * nmemb;
+        static size_t writeStreamFunction(const char* ptr, size_t size, Message* msg) {
+            OPENAI_LOG_TRACE("stream_received", "%s: %.*s", messageTypeToString(msg->getType()).c_str(), static_cast<int>(size), ptr);
+            msg->setAIResponse(ptr, size);
+            return size;
         }
 
 
 
     private:
-        CURL* curl_; ///< The curl session
-        CURLcode    res_; ///< The curl result
-        std::string url_; ///< The url to make the request to
         std::string token_; ///< The token to use for authentication
-        std::mutex  mutex_request_; ///< Mutex to avoid concurrent requests
     };
 
     /// @brief Class to handle the OpenAI API
@@ -388,14 +2117,18 @@ namespace openai {
     public:
         /// @brief Construct a new OpenAI object
         /// @param token The token to use for authentication (optional if set as environment variable (OPENAI_API_KEY)
+        /// The API base URL can be overridden with the OPENAI_BASE_URL environment variable or setBaseUrl()
         OpenAI(const std::string& token = "")
             : token_{ token } {
+            if (const char* env_p = std::getenv("OPENAI_BASE_URL")) {
+                setBaseUrl(env_p);
+            }
             if (token.empty()) { // If no token is provided, try to get it from the environment variable
                 if (const char* env_p = std::getenv("OPENAI_API_KEY")) {
                     token_ = std::string{ env_p }; // Set the token from the environment variable
                 }
                 else { // If the environment variable is not set, log an error
-                    std::cout << "OPENAI_API_KEY environment variable not set" << '\n';
+                    OPENAI_LOG_WARN("missing_api_key", "OPENAI_API_KEY environment variable not set");
                 }
             }
             session_.setToken(token_);
@@ -406,57 +2139,446 @@ namespace openai {
         OpenAI(OpenAI&&) = delete;
         OpenAI& operator=(OpenAI&&) = delete;
 
-        bool post(const std::string& suffix, const std::string& data, SharedData* shared_data = nullptr, Message* message = nullptr) {
+        /// @brief Send requests to another server, e.g. a proxy or the local MockServer
+        /// @param url Base URL such as "http://127.0.0.1:8080/v1/"; a missing trailing '/' is added
+        void setBaseUrl(std::string url) {
+            if (!url.empty() && url.back() != '/') {
+                url += '/';
+            }
+            base_url = std::move(url);
+        }
+
+        const std::string& baseUrl() const { return base_url; }
+
+        /// @brief Options of speech requests that do not pass their own template
+        /// @throws std::invalid_argument if there is no decoder for `options.format` (AAC)
+        void setTtsOptions(TtsOptions options) {
+            tts_template_ = std::make_shared<const TtsRequestTemplate>(std::move(options));
+        }
+
+        const TtsOptions& ttsOptions() const { return tts_template_->options(); }
+
+        /// @brief Serve repeated speech requests from a persistent on-disk cache (nullptr to disable)
+        void setSpeechCache(std::shared_ptr<SpeechCache> cache) {
+            speech_cache_ = std::move(cache);
+        }
+
+        /// @brief Start a request without waiting for it; other requests may run concurrently
+        /// @return Handle to wait on or cancel the transfer, nullptr if there is nowhere to put the response
+        RequestHandle postAsync(const std::string& suffix, const std::string& data, SharedData* shared_data = nullptr, Message* message = nullptr,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }) {
             auto complete_url = base_url + suffix;
-            session_.setUrl(complete_url);
-            session_.setBody(data);
-#if DEBUG
-            std::cout << "<< request: " + complete_url + "  " + data + "\n";
-#endif
+            OPENAI_LOG_DEBUG("request", "%s %s", complete_url.c_str(), data.c_str());
             if (message) {
-                return session_.makeStreamRequest(message);
+                return session_.submitStreamRequest(complete_url, data, message, timeout);
             }
             else if (shared_data) {
-                return session_.makeRequest(shared_data);
+                return session_.submitRequest(complete_url, data, shared_data, timeout);
             }
             else {
-                std::cout << "No file path or message provided\n";
-                return false;
+                OPENAI_LOG_ERROR("request_without_output", "No shared data or message provided for %s", complete_url.c_str());
+                return nullptr;
             }
         }
 
+        bool post(const std::string& suffix, const std::string& data, SharedData* shared_data = nullptr, Message* message = nullptr) {
+            RequestHandle request = postAsync(suffix, data, shared_data, message);
+            return request && request->wait();
+        }
+
+        RequestHandle chatAsync(const std::string& input, Message* message,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }) {
+            return postAsync("chat/completions", input, nullptr, message, timeout);
+        }
+
         bool chat(const std::string& input, Message* message) {
 		    return post("chat/completions", input, nullptr, message);
 	    }
 
-        bool textToSpeech(const std::string& text, SharedData* shared_data) {
-            shared_data->initOpusDecoder();
+        /// @brief Start synthesizing `text` into `shared_data` without waiting for the download to finish
+        RequestHandle textToSpeechAsync(const std::string& text, SharedData* shared_data,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }) {
+            return textToSpeechAsync(text, shared_data, *tts_template_, timeout);
+        }
+
+        /// @brief Start synthesizing `text` with the model, voice and format of `request`
+        RequestHandle textToSpeechAsync(const std::string& text, SharedData* shared_data, const TtsRequestTemplate& request,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds{ 0 }) {
+            shared_data->startDecoder(request.options().format);
+            std::string dataStr = request.build(text);
+
+            // Serve repeated phrases from the cache without a network round trip
+            std::shared_ptr<SpeechCache> cache = speech_cache_;
+            std::string cached;
+            if (cache && cache->lookup(dataStr, cached)) {
+                for (size_t offset = 0; offset < cached.size(); offset += CACHE_CHUNK_SIZE) {
+                    shared_data->pushChunk(cached.data() + offset, std::min(CACHE_CHUNK_SIZE, cached.size() - offset));
+                }
+                shared_data->endOfStream();
+                return Transfer::completed();
+            }
 
-            // Prepare the data for the TTS request
-            nlohmann::json data;
-            data["input"] = text; // Set the input text for the TTS request
-            data["model"] = "tts-1-hd"; // Set the model to use for the TTS request
-            data["voice"] = "alloy"; // Set the voice to use for the TTS request
-            data["response_format"] = "opus"; // Set the response format to use for the TTS request
-            data["speed"] = 1.0f; // Set the speed to use for the TTS request
+            RequestHandle transfer;
+            if (!cache) {
+                transfer = postAsync("audio/speech", dataStr, shared_data, nullptr, timeout);
+            }
+            else {
+                OPENAI_LOG_DEBUG("request", "%saudio/speech %s", base_url.c_str(), dataStr.c_str());
+                transfer = session_.submitRequest(base_url + "audio/speech", dataStr, shared_data, timeout,
+                    [cache, dataStr](std::string&& response, CURLcode result, long httpStatus) {
+                        if (result == CURLE_OK && httpStatus == 200 && !response.empty()) {
+                            cache->store(dataStr, response);
+                        }
+                    });
+            }
+            shared_data->setTransfer(transfer); // Lets interrupt() abort the download
+            return transfer;
+        }
 
-            std::string dataStr = data.dump();
-            std::cout << "Sending text to speech request with: " << dataStr << "\n";
+        bool textToSpeech(const std::string& text, SharedData* shared_data) {
+            return textToSpeech(text, shared_data, *tts_template_);
+        }
 
-            bool success = post("audio/speech", dataStr, shared_data);
+        bool textToSpeech(const std::string& text, SharedData* shared_data, const TtsRequestTemplate& request) {
+            bool success = textToSpeechAsync(text, shared_data, request)->wait();
+            shared_data->stopDecoder(); // Wait for the decoder to drain what was received
 
             return success;
 
         }
 
+        /// @brief Chunked mode: split `text` at sentence boundaries and synthesize up to `maxParallel` segments at once
+        ///
+        /// The first segment starts playing as soon as it arrives; the rest are stitched into `shared_data` in order.
+        /// @return true if every segment was synthesized
+        bool textToSpeech(const std::string& text, SharedData* shared_data, size_t maxParallel);
+
     private:
+        static constexpr size_t CACHE_CHUNK_SIZE = 16384; ///< Chunk size used to feed cached audio to the decoder
+
         Session session_;
+        std::shared_ptr<SpeechCache> speech_cache_; ///< Optional cache of synthesized audio
+        std::shared_ptr<const TtsRequestTemplate> tts_template_ = std::make_shared<const TtsRequestTemplate>(); ///< Default speech request options
         std::string token_;
         std::string organization_;
         std::string base_url = "https://api.openai.com/v1/";
     };
 
 
+    /**
+    * @brief Streams a chat completion into speech one segment at a time
+    *
+    * Deltas from a streaming Message are cut into sentences by a SentenceSegmenter. Each segment is
+    * synthesized as soon as it is complete (at most `maxParallel` segments started and not yet played) into its own decoder,
+    * and a sequencer thread copies the decoded audio into the output buffer strictly in segment order,
+    * so playback of the first sentence starts while the rest of the response is still being generated.
+    */
+    class SpeechPipeline {
+    public:
+        /// @brief Create a pipeline feeding `output`, which is typically played with playAudio()
+        /// @param cancellation Optional token that interrupts the pipeline when cancelled (barge-in)
+        SpeechPipeline(OpenAI& openAI, SharedData* output, size_t maxParallel = 2,
+            std::shared_ptr<CancellationToken> cancellation = nullptr)
+            : openAI_{ openAI }, output_{ output }, maxParallel_{ maxParallel > 0 ? maxParallel : 1 },
+            cancellation_{ std::move(cancellation) } {
+            sequencer_ = std::thread([this] { run(); });
+            if (cancellation_) {
+                cancellationId_ = cancellation_->addListener([this] { interrupt(); });
+            }
+        }
+
+        ~SpeechPipeline() {
+            if (cancellation_) {
+                cancellation_->removeListener(cancellationId_);
+            }
+            finish();
+            wait();
+        }
+
+        SpeechPipeline(const SpeechPipeline&) = delete;
+        SpeechPipeline& operator=(const SpeechPipeline&) = delete;
+
+        /// @brief Route the streamed deltas of `message` into this pipeline
+        void attach(Message& message) {
+            message.setDeltaCallback([this](std::string_view delta, bool finished) {
+                onDelta(delta, finished);
+            });
+        }
+
+        /// @brief Feed a streamed delta; completed segments are queued for synthesis immediately
+        void onDelta(std::string_view delta, bool finished) {
+            std::vector<std::string> segments;
+            {
+                std::lock_guard<std::mutex> lock(segmenterMutex_);
+                segments = segmenter_.push(delta);
+                if (finished) {
+                    std::string rest = segmenter_.flush();
+                    if (!rest.empty()) {
+                        segments.push_back(std::move(rest));
+                    }
+                }
+            }
+            for (auto& segment : segments) {
+                speak(segment);
+            }
+            if (finished) {
+                finish();
+            }
+        }
+
+        /// @brief Queue a complete segment of text for synthesis
+        void speak(const std::string& text) {
+            auto segment = std::make_unique<Segment>();
+            segment->text = text;
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments_.push_back(std::move(segment));
+            cv_.notify_all();
+        }
+
+        /// @brief Signal that no more segments will be queued
+        void finish() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+            cv_.notify_all();
+        }
+
+        /// @brief Wait until every queued segment has been handed to the output buffer
+        void wait() {
+            if (sequencer_.joinable()) {
+                sequencer_.join();
+            }
+        }
+
+        /// @brief Abort the remaining requests; audio already in the output buffer is left alone
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+            for (auto& segment : segments_) {
+                if (segment && segment->request) {
+                    segment->request->cancel();
+                }
+            }
+            cv_.notify_all();
+        }
+
+        /// @brief Stop speaking now: abort the remaining requests and fade out and flush the output
+        ///
+        /// Unlike cancel(), audio already in the output buffer is dropped too. Does not block, so it is
+        /// safe as a CancellationToken listener (which runs under the token's lock) and from any thread:
+        /// the sequencer stops draining and flushes the output itself, so nothing is drained after the
+        /// flush. Join with wait().
+        void interrupt() {
+            output_->stats.markOnce(output_->stats.interruptNanos);
+            bool stopped;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                interrupted_ = true;
+                stopped = stopped_;
+            }
+            cancel();
+            if (stopped) {
+                output_->interrupt(); // The sequencer has already finished and will not flush it
+            }
+        }
+
+        /// @brief Number of segments queued so far
+        size_t segmentCount() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return segments_.size();
+        }
+
+        /// @brief Number of segments whose speech request failed
+        size_t failedSegments() const { return failedSegments_.load(); }
+
+    private:
+        struct Segment {
+            std::string text; ///< Text to synthesize
+            std::unique_ptr<SharedData> data; ///< Per-segment decoder and buffer
+            RequestHandle request; ///< In-flight speech request
+            size_t samplesWritten{ 0 }; ///< Samples already copied to the output
+            bool fadeIn{ false }; ///< The output did not end at this segment's join, so it is ramped in
+        };
+
+        /// @brief Sequencer loop: start requests within the parallel limit and drain segments in order
+        void run() {
+            std::vector<float> scratch(FRAMES_PER_BUFFER * CHANNELS * 4);
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!cancelled_) {
+                startSegments(lock);
+
+                if (nextToPlay_ < nextToStart_) {
+                    Segment& segment = *segments_[nextToPlay_];
+                    lock.unlock();
+                    bool done = drain(segment, scratch);
+                    lock.lock();
+                    if (done) {
+                        segments_[nextToPlay_].reset(); // Free the segment's buffer
+                        ++nextToPlay_;
+                        continue;
+                    }
+                    cv_.wait_for(lock, std::chrono::milliseconds(2));
+                }
+                else if (finished_ && nextToPlay_ == segments_.size()) {
+                    break;
+                }
+                else {
+                    cv_.wait(lock);
+                }
+            }
+
+            stopped_ = true; // An interrupt() from now on flushes the output itself
+            bool flush = interrupted_;
+            std::vector<RequestHandle> pending;
+            for (size_t i = nextToPlay_; i < nextToStart_; ++i) {
+                if (segments_[i] && segments_[i]->request) {
+                    pending.push_back(segments_[i]->request);
+                }
+            }
+            lock.unlock();
+
+            if (flush) {
+                output_->interrupt(); // Nothing is drained into the output from here on
+            }
+            // Wait for any transfer still owned by a segment before its decoder goes away. Not under the
+            // lock: the I/O thread finishing them may be waiting for it in speak().
+            for (auto& request : pending) {
+                request->cancel();
+                request->wait();
+            }
+        }
+
+        /// @brief Start synthesis of queued segments while fewer than maxParallel_ are started but not yet drained
+        ///
+        /// A segment holds its SEGMENT_BUFFER_CAPACITY buffer and decode thread until it has been played,
+        /// so segments that have finished downloading still count towards the limit. `lock` (on mutex_) is
+        /// released while the requests are started: that spawns decode threads and may read a cached
+        /// response from disk, and speak() is called from the RequestEngine I/O thread.
+        void startSegments(std::unique_lock<std::mutex>& lock) {
+            std::vector<Segment*> starting;
+            while (nextToStart_ < segments_.size() && nextToStart_ - nextToPlay_ < maxParallel_) {
+                starting.push_back(segments_[nextToStart_++].get());
+            }
+            if (starting.empty()) {
+                return;
+            }
+
+            lock.unlock();
+            for (Segment* segment : starting) {
+                segment->data = std::make_unique<SharedData>(nullptr, SEGMENT_BUFFER_CAPACITY);
+                RequestHandle request = openAI_.textToSpeechAsync(segment->text, segment->data.get());
+                lock.lock();
+                segment->request = std::move(request); // cancel() reads it under the lock
+                if (cancelled_ && segment->request) {
+                    segment->request->cancel();
+                }
+                lock.unlock();
+            }
+            lock.lock();
+        }
+
+        /// @brief Move whatever the segment has decoded into the output buffer
+        ///
+        /// Decoded segments are trimmed to their exact length, so consecutive segments are passed through
+        /// unchanged. DECLICK_SAMPLES ramps are only applied where the audio is discontinuous: into the
+        /// first segment of the stream and any segment following a cut, and out of a segment whose request
+        /// failed or that ends the stream. The tail is held back until the segment is fully decoded so it
+        /// can still be faded.
+        /// @return true once the segment is fully decoded and drained
+        bool drain(Segment& segment, std::vector<float>& scratch) {
+            bool decoded = segment.data->decoderDone; // Read before draining so no sample is left behind
+            AudioBuffer& source = segment.data->audioBuffer;
+            size_t available = source.size();
+            size_t holdBack = decoded ? 0 : DECLICK_SAMPLES;
+
+            bool failed = false;
+            bool fadeOut = false;
+            if (decoded) {
+                failed = segment.request && !segment.request->wait();
+                fadeOut = failed || endsStream(segment);
+            }
+            if (segment.samplesWritten == 0) {
+                segment.fadeIn = !joinsPrevious_;
+            }
+
+            while (available > holdBack && !interrupted_) {
+                size_t n = std::min({ scratch.size(), available - holdBack, output_->audioBuffer.freeSpace() });
+                n = source.read(scratch.data(), n);
+                if (n == 0) {
+                    break;
+                }
+                for (size_t i = 0; segment.fadeIn && i < n && segment.samplesWritten + i < DECLICK_SAMPLES; ++i) {
+                    scratch[i] *= static_cast<float>(segment.samplesWritten + i) / DECLICK_SAMPLES;
+                }
+                for (size_t i = 0; fadeOut && i < n; ++i) {
+                    size_t remaining = available - i;
+                    if (remaining <= DECLICK_SAMPLES) {
+                        scratch[i] *= static_cast<float>(remaining - 1) / DECLICK_SAMPLES;
+                    }
+                }
+                output_->audioBuffer.write(scratch.data(), n);
+                segment.samplesWritten += n;
+                available -= n;
+            }
+
+            if (decoded && source.isEmpty()) {
+                if (failed) {
+                    failedSegments_ += 1;
+                }
+                // A segment without audio leaves the join as it was, unless its request failed
+                if (segment.samplesWritten > 0 || failed) {
+                    joinsPrevious_ = !fadeOut;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        /// @brief Whether `segment` is the last one and no more will be queued
+        bool endsStream(const Segment& segment) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return finished_ && !segments_.empty() && segments_.back().get() == &segment;
+        }
+
+        static constexpr size_t SEGMENT_BUFFER_CAPACITY = 1 << 20; // ~43 s per segment at 24 kHz
+        static constexpr size_t DECLICK_SAMPLES = SAMPLE_RATE / 400 * CHANNELS; // 2.5 ms ramp where the audio is cut
+
+        OpenAI& openAI_; ///< Client used for the speech requests
+        SharedData* output_; ///< Buffer played by the audio callback
+        size_t maxParallel_; ///< Maximum number of segments started and not yet played
+        std::shared_ptr<CancellationToken> cancellation_; ///< Token that interrupts the pipeline, if any
+        size_t cancellationId_{ 0 }; ///< Listener registered on cancellation_
+
+        std::mutex segmenterMutex_; ///< Protects segmenter_
+        SentenceSegmenter segmenter_; ///< Cuts streamed deltas into segments
+
+        mutable std::mutex mutex_; ///< Protects the segment queue and flags below
+        std::condition_variable cv_; ///< Signalled when segments are queued or the pipeline is finished
+        std::vector<std::unique_ptr<Segment>> segments_; ///< Every segment, in playback order
+        size_t nextToStart_{ 0 }; ///< First segment whose request has not been started
+        size_t nextToPlay_{ 0 }; ///< Segment currently being drained into the output
+        bool finished_{ false };
+        bool cancelled_{ false };
+        std::atomic<bool> interrupted_{ false }; ///< interrupt() was called; the sequencer flushes the output when it stops
+        bool stopped_{ false }; ///< The sequencer has left its loop
+        std::atomic<size_t> failedSegments_{ 0 };
+        bool joinsPrevious_{ false }; ///< The output ends cleanly at a segment boundary (sequencer thread only)
+
+        std::thread sequencer_; ///< Runs run()
+    };
+
+    inline bool OpenAI::textToSpeech(const std::string& text, SharedData* shared_data, size_t maxParallel) {
+        shared_data->beginResponse(); // A reused buffer would otherwise still look finished
+        SpeechPipeline pipeline{ *this, shared_data, maxParallel };
+        for (const auto& segment : SentenceSegmenter::split(text)) {
+            pipeline.speak(segment);
+        }
+        pipeline.finish();
+        pipeline.wait();
+        shared_data->decoderDone = true; // Everything has been handed to the output buffer
+        return pipeline.failedSegments() == 0;
+    }
+
+
 } // namespace openai
 
 #endif // OPENAI_REDUCED_HPP_
@@ -0,0 +1,217 @@
+#ifndef OPUS_FRAME_CHECK_HPP_
+#define OPUS_FRAME_CHECK_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+#include "openai-reduced.hpp"
+
+namespace openai {
+
+    namespace detail {
+
+        constexpr ogg_int64_t CHECK_GRANULE_RATE = 48000; ///< Ogg Opus granule positions are always at 48 kHz
+
+        /// @brief Append every page libogg has ready (all of them when `flush` is set) to `out`
+        inline void drainPages(ogg_stream_state& os, std::string& out, bool flush) {
+            ogg_page page;
+            while (flush ? ogg_stream_flush(&os, &page) : ogg_stream_pageout(&os, &page)) {
+                out.append(reinterpret_cast<const char*>(page.header), page.header_len);
+                out.append(reinterpret_cast<const char*>(page.body), page.body_len);
+            }
+        }
+
+        /// @brief An Ogg Opus stream of the kind the speech endpoint returns
+        struct EncodedStream {
+            std::string bytes;
+            size_t packets{ 0 };
+            int tocSamples{ 0 }; ///< Duration of the first packet read back from its TOC, in samples at SAMPLE_RATE
+            int preSkip{ 0 }; ///< Encoder lookahead in samples at SAMPLE_RATE
+            size_t endTrim{ 0 }; ///< Samples at the end cut off by the last granule position
+        };
+
+        /// @brief Encode `frames` frames of `frameSize` samples of a tone with libopus into an Ogg Opus stream
+        ///
+        /// Pages are flushed every 100 ms like a streaming encoder would, and the last granule position
+        /// ends the stream half a frame early so the end trimming is exercised too.
+        /// @return false if libopus rejects the frame size
+        inline bool encodeOggOpus(int frameSize, size_t frames, EncodedStream& stream, std::string& error) {
+            int opusError = OPUS_OK;
+            OpusEncoder* encoder = opus_encoder_create(SAMPLE_RATE, CHANNELS, OPUS_APPLICATION_AUDIO, &opusError);
+            if (opusError != OPUS_OK) {
+                error = opus_strerror(opusError);
+                return false;
+            }
+            opus_encoder_ctl(encoder, OPUS_GET_LOOKAHEAD(&stream.preSkip));
+            const ogg_int64_t granulePerSample = CHECK_GRANULE_RATE / SAMPLE_RATE;
+            const ogg_int64_t preSkip = stream.preSkip * granulePerSample;
+
+            ogg_stream_state os;
+            ogg_stream_init(&os, 0x0905);
+
+            // OpusHead and OpusTags, each on a page of its own
+            unsigned char head[19] = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, static_cast<unsigned char>(CHANNELS),
+                static_cast<unsigned char>(preSkip & 0xFF), static_cast<unsigned char>(preSkip >> 8),
+                static_cast<unsigned char>(SAMPLE_RATE & 0xFF), static_cast<unsigned char>((SAMPLE_RATE >> 8) & 0xFF),
+                static_cast<unsigned char>((SAMPLE_RATE >> 16) & 0xFF), 0, 0, 0, 0 };
+            unsigned char tags[16] = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's', 0, 0, 0, 0, 0, 0, 0, 0 };
+            ogg_packet packet{};
+            packet.packet = head;
+            packet.bytes = sizeof(head);
+            packet.b_o_s = 1;
+            ogg_stream_packetin(&os, &packet);
+            drainPages(os, stream.bytes, true);
+            packet = ogg_packet{};
+            packet.packet = tags;
+            packet.bytes = sizeof(tags);
+            packet.packetno = 1;
+            ogg_stream_packetin(&os, &packet);
+            drainPages(os, stream.bytes, true);
+
+            std::vector<float> pcm(static_cast<size_t>(frameSize) * CHANNELS);
+            std::vector<unsigned char> data(1275 * 6 + 6); // Largest possible 120 ms packet
+            stream.endTrim = static_cast<size_t>(frameSize) / 2;
+            ogg_int64_t granule = 0;
+            ogg_int64_t pageStart = 0;
+            bool ok = true;
+            for (size_t frame = 0; frame < frames; ++frame) {
+                for (int i = 0; i < frameSize; ++i) {
+                    float t = static_cast<float>(frame * frameSize + i) / SAMPLE_RATE;
+                    for (int c = 0; c < CHANNELS; ++c) {
+                        pcm[static_cast<size_t>(i) * CHANNELS + c] = 0.5f * std::sin(2.0f * 3.14159265f * 440.0f * t);
+                    }
+                }
+                opus_int32 bytes = opus_encode_float(encoder, pcm.data(), frameSize, data.data(), static_cast<opus_int32>(data.size()));
+                if (bytes < 0) {
+                    error = opus_strerror(bytes);
+                    ok = false;
+                    break;
+                }
+                if (frame == 0) {
+                    stream.tocSamples = opus_packet_get_nb_samples(data.data(), bytes, SAMPLE_RATE);
+                }
+
+                bool last = frame + 1 == frames;
+                granule += frameSize * granulePerSample;
+                packet = ogg_packet{};
+                packet.packet = data.data();
+                packet.bytes = bytes;
+                packet.e_o_s = last ? 1 : 0;
+                packet.granulepos = last ? granule - static_cast<ogg_int64_t>(stream.endTrim) * granulePerSample : granule;
+                packet.packetno = static_cast<ogg_int64_t>(2 + frame);
+                ogg_stream_packetin(&os, &packet);
+                stream.packets += 1;
+                if (last || granule - pageStart >= CHECK_GRANULE_RATE / 10) {
+                    drainPages(os, stream.bytes, true);
+                    pageStart = granule;
+                }
+            }
+
+            ogg_stream_clear(&os);
+            opus_encoder_destroy(encoder);
+            return ok;
+        }
+
+        /// @brief Encode one frame duration, play the stream through OggOpusDecoder and compare the counts
+        inline nlohmann::json checkOpusFrameSize(double frameMs, double streamMs) {
+            const int frameSize = static_cast<int>(std::lround(frameMs * SAMPLE_RATE / 1000.0));
+            const size_t frames = static_cast<size_t>(std::lround(streamMs / frameMs));
+            nlohmann::json result{ {"frame_ms", frameMs}, {"frame_samples", frameSize}, {"packets", frames} };
+
+            EncodedStream stream;
+            std::string error;
+            if (!encodeOggOpus(frameSize, frames, stream, error)) {
+                result["error"] = error;
+                result["ok"] = false;
+                return result;
+            }
+
+            // A ring much shorter than the stream, drained after every chunk like the playback callback,
+            // so decodes land on both sides of the wrap-around
+            AudioBuffer buffer{ 8192 };
+            PipelineStats stats;
+            JitterBuffer jitter;
+            OggOpusDecoder decoder{ buffer, stats, jitter };
+            decoder.start();
+            std::vector<float> output(buffer.capacity());
+            size_t played = 0;
+            double energy = 0.0;
+            auto drain = [&] {
+                size_t n;
+                while ((n = buffer.read(output.data(), output.size())) > 0) {
+                    for (size_t i = 0; i < n; ++i) {
+                        energy += static_cast<double>(output[i]) * output[i];
+                    }
+                    played += n;
+                }
+            };
+            const size_t chunkSize = 512;
+            for (size_t offset = 0; offset < stream.bytes.size(); offset += chunkSize) {
+                decoder.decode(stream.bytes.data() + offset, std::min(chunkSize, stream.bytes.size() - offset));
+                drain();
+            }
+            decoder.finish();
+            drain();
+
+            const size_t encoded = frames * static_cast<size_t>(frameSize) * CHANNELS;
+            const size_t expected = encoded - (static_cast<size_t>(stream.preSkip) + stream.endTrim) * CHANNELS;
+            bool ok = stream.tocSamples == frameSize
+                && stats.packetsDecoded.load() == frames
+                && stats.samplesDecoded.load() == encoded
+                && played == expected
+                && buffer.dropped() == 0
+                && stats.corruptPackets.load() == 0
+                && stats.plcFrames.load() == 0
+                && stats.lostPages.load() == 0;
+            result["toc_samples"] = stream.tocSamples;
+            result["stream_bytes"] = stream.bytes.size();
+            result["samples_decoded"] = stats.samplesDecoded.load();
+            result["expected_samples_decoded"] = encoded;
+            result["ring_samples"] = played;
+            result["expected_ring_samples"] = expected;
+            result["pre_skip"] = stream.preSkip;
+            result["end_trim"] = stream.endTrim;
+            result["rms"] = played > 0 ? std::sqrt(energy / played) : 0.0;
+            result["ok"] = ok;
+            return result;
+        }
+
+    } // namespace detail
+
+    /**
+    * @brief Check that every Opus frame duration decodes to the right number of samples
+    *
+    * Encodes a tone with libopus at each duration Opus allows (2.5 to 120 ms), muxes it into Ogg the
+    * way a streaming encoder would and feeds it through OggOpusDecoder into a small AudioBuffer that is
+    * drained as it fills. For each duration the packet TOC must report the frame size, the decoder must
+    * count every encoded sample, and the ring must receive exactly those samples minus the pre-skip
+    * and the end trim, with nothing dropped or concealed.
+    * @return 0 if every duration passed
+    */
+    inline int opus_frame_check_main() {
+        const double frameDurations[] = { 2.5, 5.0, 10.0, 20.0, 40.0, 60.0, 120.0 };
+        const double streamMs = 960.0; // A whole number of frames at every duration
+
+        nlohmann::json results = nlohmann::json::array();
+        bool allOk = true;
+        for (double frameMs : frameDurations) {
+            nlohmann::json result = detail::checkOpusFrameSize(frameMs, streamMs);
+            allOk = allOk && result["ok"].get<bool>();
+            results.push_back(std::move(result));
+        }
+        nlohmann::json summary{ {"sample_rate", SAMPLE_RATE}, {"channels", CHANNELS}, {"ok", allOk}, {"frame_sizes", results} };
+        std::cout << "Opus frame check: " << summary.dump(2) << std::endl;
+        return allOk ? 0 : 1;
+    }
+
+} // namespace openai
+
+#endif // OPUS_FRAME_CHECK_HPP_
@@ -0,0 +1,131 @@
+#ifndef OPUS_HEADER_HPP_
+#define OPUS_HEADER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /**
+    * @brief Identification header of an Ogg Opus stream (RFC 7845, section 5.1)
+    *
+    * Fields keep their on-the-wire units: pre-skip is in 48 kHz samples and the output gain is a Q7.8
+    * dB value, which is exactly what OPUS_SET_GAIN expects.
+    */
+    struct OpusHead {
+        uint8_t version{ 1 };
+        int channels{ 1 }; ///< Output channel count
+        int preSkip{ 0 }; ///< Samples at 48 kHz to discard from the start of the decoded stream
+        uint32_t inputSampleRate{ 0 }; ///< Rate of the original input, informational only
+        int16_t outputGain{ 0 }; ///< Gain to apply to the decoded output, Q7.8 dB
+        int mappingFamily{ 0 }; ///< 0: mono/stereo in one stream, 1 or 255: multistream
+        int streams{ 1 }; ///< Number of Opus streams in each packet
+        int coupledStreams{ 0 }; ///< How many of those streams are stereo
+        std::vector<unsigned char> mapping{ 0 }; ///< Decoder output channel for each stream channel
+
+        /// @brief Parse an "OpusHead" packet
+        /// @return false if the packet is not a valid identification header
+        static bool parse(const unsigned char* data, size_t size, OpusHead& head) {
+            if (size < 19 || std::memcmp(data, "OpusHead", 8) != 0 || (data[8] & 0xF0) != 0) {
+                return false; // Major versions other than 0 are incompatible
+            }
+            head.version = data[8];
+            head.channels = data[9];
+            head.preSkip = data[10] | (data[11] << 8);
+            head.inputSampleRate = static_cast<uint32_t>(data[12]) | (static_cast<uint32_t>(data[13]) << 8)
+                | (static_cast<uint32_t>(data[14]) << 16) | (static_cast<uint32_t>(data[15]) << 24);
+            head.outputGain = static_cast<int16_t>(data[16] | (data[17] << 8));
+            head.mappingFamily = data[18];
+            if (head.channels == 0) {
+                return false;
+            }
+
+            if (head.mappingFamily == 0) {
+                if (head.channels > 2) {
+                    return false;
+                }
+                head.streams = 1;
+                head.coupledStreams = head.channels - 1;
+                head.mapping = head.channels == 1 ? std::vector<unsigned char>{ 0 } : std::vector<unsigned char>{ 0, 1 };
+                return true;
+            }
+
+            if (size < 21 + static_cast<size_t>(head.channels)) {
+                return false;
+            }
+            head.streams = data[19];
+            head.coupledStreams = data[20];
+            head.mapping.assign(data + 21, data + 21 + head.channels);
+            return head.streams > 0 && head.coupledStreams <= head.streams;
+        }
+
+        nlohmann::json toJson() const {
+            return nlohmann::json{
+                {"version", version},
+                {"channels", channels},
+                {"pre_skip", preSkip},
+                {"input_sample_rate", inputSampleRate},
+                {"output_gain_db", outputGain / 256.0},
+                {"mapping_family", mappingFamily},
+                {"streams", streams},
+                {"coupled_streams", coupledStreams}
+            };
+        }
+    };
+
+    /// @brief Comment header of an Ogg Opus stream (RFC 7845, section 5.2)
+    struct OpusTags {
+        std::string vendor;
+        std::vector<std::string> comments; ///< "NAME=value" pairs
+
+        /// @brief Parse an "OpusTags" packet
+        /// @return false if the packet is not a valid comment header
+        static bool parse(const unsigned char* data, size_t size, OpusTags& tags) {
+            if (size < 16 || std::memcmp(data, "OpusTags", 8) != 0) {
+                return false;
+            }
+            size_t position = 8;
+            auto readLength = [&](uint32_t& value) {
+                if (size - position < 4) {
+                    return false;
+                }
+                value = static_cast<uint32_t>(data[position]) | (static_cast<uint32_t>(data[position + 1]) << 8)
+                    | (static_cast<uint32_t>(data[position + 2]) << 16) | (static_cast<uint32_t>(data[position + 3]) << 24);
+                position += 4;
+                return true;
+            };
+
+            uint32_t length = 0;
+            if (!readLength(length) || size - position < length) {
+                return false;
+            }
+            tags.vendor.assign(reinterpret_cast<const char*>(data + position), length);
+            position += length;
+
+            uint32_t count = 0;
+            if (!readLength(count)) {
+                return false;
+            }
+            tags.comments.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!readLength(length) || size - position < length) {
+                    return false;
+                }
+                tags.comments.emplace_back(reinterpret_cast<const char*>(data + position), length);
+                position += length;
+            }
+            return true;
+        }
+
+        nlohmann::json toJson() const {
+            return nlohmann::json{ {"vendor", vendor}, {"comments", comments} };
+        }
+    };
+
+} // namespace openai
+
+#endif // OPUS_HEADER_HPP_
@@ -0,0 +1,427 @@
+#ifndef PHRASE_BANK_HPP_
+#define PHRASE_BANK_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "ChatStructures.hpp"
+#include "openai-reduced.hpp"
+
+namespace openai {
+
+    /**
+    * @brief On-disk layout of a phrase bank
+    *
+    * header | entries[phraseCount] | words[wordCount] | string blob | padding to 64 bytes | float PCM
+    *
+    * All offsets are in bytes from the start of the file except the PCM and word offsets of an entry,
+    * which index the PCM and word arrays. The PCM is SAMPLE_RATE / CHANNELS float, ready to play.
+    */
+    namespace bank {
+        const char MAGIC[4] = { 'P', 'H', 'R', 'B' };
+        const uint32_t VERSION = 1;
+        const size_t PCM_ALIGNMENT = 64;
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint32_t sampleRate;
+            uint32_t channels;
+            uint32_t phraseCount;
+            uint32_t wordCount;
+            uint64_t entriesOffset;
+            uint64_t wordsOffset;
+            uint64_t stringsOffset;
+            uint64_t pcmOffset;
+            uint64_t pcmSamples;
+        };
+
+        struct Entry {
+            uint32_t messageType; ///< MessageType of the phrase
+            uint32_t textLength;
+            uint64_t textOffset; ///< Into the string blob
+            uint64_t firstSample; ///< Into the PCM array
+            uint64_t sampleCount;
+            uint32_t firstWord; ///< Into the word array
+            uint32_t wordCount;
+        };
+
+        struct WordEntry {
+            uint64_t textOffset; ///< Into the string blob
+            uint32_t textLength;
+            uint32_t reserved;
+            int64_t startMs; ///< Start of the word relative to the start of the phrase
+        };
+    } // namespace bank
+
+    /// @brief A phrase in a PhraseBank; `clip` points straight into the mapped file
+    struct Phrase {
+        MessageType type;
+        std::string_view text;
+        PcmClip clip;
+        const bank::WordEntry* words;
+        size_t wordCount;
+        const char* strings; ///< String blob the word entries point into
+
+        /// @brief Word timings in the form Message::setWords expects
+        std::vector<Word> getWords() const {
+            std::vector<Word> result;
+            result.reserve(wordCount);
+            for (size_t i = 0; i < wordCount; ++i) {
+                result.emplace_back(std::string(strings + words[i].textOffset, words[i].textLength), words[i].startMs);
+            }
+            return result;
+        }
+    };
+
+    /**
+    * @brief Read-only, memory-mapped bank of pre-decoded cached phrases
+    *
+    * Playing a phrase hands its PcmClip to SharedData::playClip(); the audio callback then reads the
+    * samples from the mapping with no decode and no intermediate copy.
+    */
+    class PhraseBank {
+    public:
+        explicit PhraseBank(const std::filesystem::path& path) {
+            map(path);
+            const auto* header = reinterpret_cast<const bank::Header*>(data_);
+            if (size_ < sizeof(bank::Header) || !std::equal(header->magic, header->magic + 4, bank::MAGIC) || header->version != bank::VERSION) {
+                unmap();
+                throw std::runtime_error("Not a phrase bank: " + path.string());
+            }
+            if (header->sampleRate != SAMPLE_RATE || header->channels != CHANNELS) {
+                unmap();
+                throw std::runtime_error("Phrase bank sample format does not match the output: " + path.string());
+            }
+            // Every view handed out points into the mapping, so a truncated or corrupt file must be rejected here
+            if (!validLayout(*header)) {
+                unmap();
+                throw std::runtime_error("Not a phrase bank: " + path.string());
+            }
+
+            const auto* entries = reinterpret_cast<const bank::Entry*>(data_ + header->entriesOffset);
+            const auto* words = reinterpret_cast<const bank::WordEntry*>(data_ + header->wordsOffset);
+            const char* strings = data_ + header->stringsOffset;
+            const float* pcm = reinterpret_cast<const float*>(data_ + header->pcmOffset);
+            phrases_.reserve(header->phraseCount);
+            for (uint32_t i = 0; i < header->phraseCount; ++i) {
+                const bank::Entry& entry = entries[i];
+                phrases_.push_back(Phrase{
+                    static_cast<MessageType>(entry.messageType),
+                    std::string_view(strings + entry.textOffset, entry.textLength),
+                    PcmClip{ pcm + entry.firstSample, static_cast<size_t>(entry.sampleCount) },
+                    words + entry.firstWord,
+                    entry.wordCount,
+                    strings
+                });
+            }
+        }
+
+        ~PhraseBank() {
+            unmap();
+        }
+
+        PhraseBank(const PhraseBank&) = delete;
+        PhraseBank& operator=(const PhraseBank&) = delete;
+
+        const std::vector<Phrase>& phrases() const { return phrases_; }
+
+        /// @brief Find a phrase by type and, if given, exact text
+        /// @return nullptr if the bank has no such phrase
+        const Phrase* find(MessageType type, std::string_view text = {}) const {
+            for (const auto& phrase : phrases_) {
+                if (phrase.type == type && (text.empty() || phrase.text == text)) {
+                    return &phrase;
+                }
+            }
+            return nullptr;
+        }
+
+        /// @brief Start playing a phrase on `shared_data` and load its text and word timings into `message`
+        bool play(const Phrase& phrase, SharedData* shared_data, Message* message = nullptr) const {
+            if (message) {
+                message->setWords(std::string(phrase.text), phrase.getWords());
+            }
+            shared_data->playClip(&phrase.clip);
+            return true;
+        }
+
+    private:
+        /// @brief Whether `count` elements of `elementSize` bytes starting at `offset` fit in `limit` bytes (overflow-safe)
+        static bool fits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t limit) {
+            return offset <= limit && count <= (limit - offset) / elementSize;
+        }
+
+        /// @brief Check every section and every entry's ranges against the size of the mapping
+        bool validLayout(const bank::Header& header) const {
+            const uint64_t size = size_;
+            if (header.entriesOffset % alignof(bank::Entry) != 0 || header.wordsOffset % alignof(bank::WordEntry) != 0
+                || header.pcmOffset % alignof(float) != 0
+                || !fits(header.entriesOffset, header.phraseCount, sizeof(bank::Entry), size)
+                || !fits(header.wordsOffset, header.wordCount, sizeof(bank::WordEntry), size)
+                || header.stringsOffset > header.pcmOffset
+                || !fits(header.pcmOffset, header.pcmSamples, sizeof(float), size)) {
+                return false;
+            }
+
+            // The string blob runs up to the PCM; entry offsets are relative to the blob and the arrays
+            const uint64_t stringsSize = header.pcmOffset - header.stringsOffset;
+            const auto* entries = reinterpret_cast<const bank::Entry*>(data_ + header.entriesOffset);
+            const auto* words = reinterpret_cast<const bank::WordEntry*>(data_ + header.wordsOffset);
+            for (uint32_t i = 0; i < header.phraseCount; ++i) {
+                const bank::Entry& entry = entries[i];
+                if (!fits(entry.textOffset, entry.textLength, 1, stringsSize)
+                    || !fits(entry.firstSample, entry.sampleCount, 1, header.pcmSamples)
+                    || !fits(entry.firstWord, entry.wordCount, 1, header.wordCount)) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header.wordCount; ++i) {
+                if (!fits(words[i].textOffset, words[i].textLength, 1, stringsSize)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void map(const std::filesystem::path& path) {
+#ifdef _WIN32
+            file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error("Failed to open phrase bank: " + path.string());
+            }
+            LARGE_INTEGER size;
+            GetFileSizeEx(file_, &size);
+            size_ = static_cast<size_t>(size.QuadPart);
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_ == nullptr) {
+                CloseHandle(file_);
+                throw std::runtime_error("Failed to map phrase bank: " + path.string());
+            }
+            data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+            int fd = open(path.string().c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open phrase bank: " + path.string());
+            }
+            struct stat st;
+            fstat(fd, &st);
+            size_ = static_cast<size_t>(st.st_size);
+            void* data = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+            close(fd);
+            data_ = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+#endif
+            if (data_ == nullptr) {
+                unmap();
+                throw std::runtime_error("Failed to map phrase bank: " + path.string());
+            }
+        }
+
+        void unmap() {
+#ifdef _WIN32
+            if (data_) {
+                UnmapViewOfFile(data_);
+            }
+            if (mapping_) {
+                CloseHandle(mapping_);
+                mapping_ = nullptr;
+            }
+            if (file_ != INVALID_HANDLE_VALUE) {
+                CloseHandle(file_);
+                file_ = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (data_) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+#endif
+            data_ = nullptr;
+        }
+
+        const char* data_{ nullptr }; ///< Start of the mapping
+        size_t size_{ 0 }; ///< Size of the mapping
+#ifdef _WIN32
+        HANDLE file_{ INVALID_HANDLE_VALUE };
+        HANDLE mapping_{ nullptr };
+#endif
+        std::vector<Phrase> phrases_; ///< Views into the mapping
+    };
+
+    /**
+    * @brief Offline builder for a PhraseBank
+    *
+    * Typical use is renderFromManifest(), which synthesizes every phrase of a JSON manifest
+    * (`[{"type": "CachedWarn", "text": "..."}]`), decodes it to PCM and writes the bank.
+    */
+    class PhraseBankBuilder {
+    public:
+        /// @brief Add a phrase with its decoded PCM and word timings (empty to estimate them)
+        void add(MessageType type, const std::string& text, std::vector<float> pcm, std::vector<Word> words = {}) {
+            if (words.empty()) {
+                words = estimateWordTimings(text, pcm);
+            }
+            phrases_.push_back(Pending{ type, text, std::move(pcm), std::move(words) });
+        }
+
+        /// @brief Synthesize `text` and return its decoded PCM
+        static std::vector<float> render(OpenAI& openAI, const std::string& text) {
+            SharedData data{ nullptr };
+            if (!openAI.textToSpeech(text, &data)) {
+                throw std::runtime_error("Failed to synthesize phrase: " + text);
+            }
+            std::vector<float> pcm(data.audioBuffer.size());
+            pcm.resize(data.audioBuffer.read(pcm.data(), pcm.size()));
+            return pcm;
+        }
+
+        /// @brief Synthesize every phrase listed in a JSON manifest
+        void renderFromManifest(OpenAI& openAI, const std::filesystem::path& manifestPath) {
+            std::ifstream manifestFile(manifestPath);
+            if (!manifestFile) {
+                throw std::runtime_error("Failed to open phrase manifest: " + manifestPath.string());
+            }
+            Json manifest = Json::parse(std::string(std::istreambuf_iterator<char>(manifestFile), std::istreambuf_iterator<char>()));
+            for (const auto& item : manifest) {
+                MessageType type = messageTypeFromString(item["type"].get<std::string>());
+                if (!isCached(type)) {
+                    throw std::runtime_error("Phrase manifest entry is not a Cached* message type");
+                }
+                std::string text = item["text"].get<std::string>();
+                std::cout << "Rendering " << messageTypeToString(type) << ": " << text << std::endl;
+                add(type, text, render(openAI, text));
+            }
+        }
+
+        /// @brief Write the bank, replacing `path` atomically
+        void write(const std::filesystem::path& path) const {
+            std::vector<bank::Entry> entries;
+            std::vector<bank::WordEntry> words;
+            std::string strings;
+            uint64_t samples = 0;
+            for (const auto& phrase : phrases_) {
+                bank::Entry entry{};
+                entry.messageType = static_cast<uint32_t>(phrase.type);
+                entry.textOffset = strings.size();
+                entry.textLength = static_cast<uint32_t>(phrase.text.size());
+                strings += phrase.text;
+                entry.firstSample = samples;
+                entry.sampleCount = phrase.pcm.size();
+                samples += phrase.pcm.size();
+                entry.firstWord = static_cast<uint32_t>(words.size());
+                entry.wordCount = static_cast<uint32_t>(phrase.words.size());
+                for (const auto& word : phrase.words) {
+                    bank::WordEntry wordEntry{};
+                    wordEntry.textOffset = strings.size();
+                    wordEntry.textLength = static_cast<uint32_t>(word.text.size());
+                    wordEntry.startMs = word.start;
+                    strings += word.text;
+                    words.push_back(wordEntry);
+                }
+                entries.push_back(entry);
+            }
+
+            bank::Header header{};
+            std::copy(bank::MAGIC, bank::MAGIC + 4, header.magic);
+            header.version = bank::VERSION;
+            header.sampleRate = SAMPLE_RATE;
+            header.channels = CHANNELS;
+            header.phraseCount = static_cast<uint32_t>(entries.size());
+            header.wordCount = static_cast<uint32_t>(words.size());
+            header.entriesOffset = sizeof(header);
+            header.wordsOffset = header.entriesOffset + entries.size() * sizeof(bank::Entry);
+            header.stringsOffset = header.wordsOffset + words.size() * sizeof(bank::WordEntry);
+            header.pcmOffset = (header.stringsOffset + strings.size() + bank::PCM_ALIGNMENT - 1) / bank::PCM_ALIGNMENT * bank::PCM_ALIGNMENT;
+            header.pcmSamples = samples;
+
+            std::filesystem::path temporary = path;
+            temporary += ".tmp";
+            {
+                std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(bank::Entry));
+                out.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(bank::WordEntry));
+                out.write(strings.data(), strings.size());
+                std::string padding(header.pcmOffset - (header.stringsOffset + strings.size()), '\0');
+                out.write(padding.data(), padding.size());
+                for (const auto& phrase : phrases_) {
+                    out.write(reinterpret_cast<const char*>(phrase.pcm.data()), phrase.pcm.size() * sizeof(float));
+                }
+                if (!out) {
+                    throw std::runtime_error("Failed to write phrase bank: " + temporary.string());
+                }
+            }
+            std::filesystem::rename(temporary, path);
+        }
+
+        /// @brief Estimate word start times by spreading the voiced part of `pcm` over the words by length
+        static std::vector<Word> estimateWordTimings(const std::string& text, const std::vector<float>& pcm) {
+            const float threshold = 0.01f;
+            size_t first = 0;
+            while (first < pcm.size() && std::abs(pcm[first]) < threshold) {
+                ++first;
+            }
+            size_t last = pcm.size();
+            while (last > first && std::abs(pcm[last - 1]) < threshold) {
+                --last;
+            }
+
+            std::vector<std::string> tokens;
+            size_t characters = 0;
+            size_t pos = 0;
+            while ((pos = text.find_first_not_of(" \t\r\n", pos)) != std::string::npos) {
+                size_t end = text.find_first_of(" \t\r\n", pos);
+                tokens.push_back(text.substr(pos, end - pos));
+                characters += tokens.back().size();
+                pos = end;
+            }
+
+            std::vector<Word> words;
+            const double msPerSample = 1000.0 / (SAMPLE_RATE * CHANNELS);
+            size_t consumed = 0;
+            for (const auto& token : tokens) {
+                double fraction = characters > 0 ? static_cast<double>(consumed) / characters : 0.0;
+                long long start = static_cast<long long>((first + fraction * (last - first)) * msPerSample);
+                words.emplace_back(token, start);
+                consumed += token.size();
+            }
+            return words;
+        }
+
+    private:
+        struct Pending {
+            MessageType type;
+            std::string text;
+            std::vector<float> pcm;
+            std::vector<Word> words;
+        };
+
+        std::vector<Pending> phrases_;
+    };
+
+} // namespace openai
+
+#endif // PHRASE_BANK_HPP_
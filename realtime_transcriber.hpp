@@ -0,0 +1,464 @@
+#ifndef REALTIME_TRANSCRIBER_HPP_
+#define REALTIME_TRANSCRIBER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+#include "ChatStructures.hpp"
+#include "assemblyai.h"
+#include "audio_source.hpp"
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+#include "openai-reduced.hpp"
+#include "token_manager.hpp"
+
+namespace assemblyai {
+
+    /**
+    * @brief Realtime speech-to-text over the AssemblyAI websocket API
+    *
+    * Captured audio is pushed from the capture callback into a lock-free ring; a network thread cuts
+    * it into frameDuration frames of 16-bit little-endian PCM at the session sample rate, sends them
+    * as binary websocket frames and feeds PartialTranscript and FinalTranscript results into the
+    * Message. Sending and receiving share one thread because a curl easy handle may only be used from
+    * one thread at a time.
+    *
+    * Capture-to-partial latency is measured for every transcript: the time from the moment the
+    * audio a result ends with was captured to the moment the result arrived.
+    */
+    class RealtimeTranscriber {
+    public:
+        struct Options {
+            int sampleRate{ 16000 }; ///< Rate negotiated in the websocket URL; capture runs at this rate
+            std::vector<std::string> wordBoost; ///< Phrases the recognizer should favour
+            std::chrono::milliseconds frameDuration{ 100 }; ///< Audio per upload; the API accepts 100 to 2000 ms
+            unsigned long framesPerBuffer{ 320 }; ///< Capture callback period, 20 ms at 16 kHz
+            std::chrono::milliseconds connectTimeout{ 10000 };
+            std::chrono::milliseconds closeTimeout{ 2000 }; ///< How long stop() waits for SessionTerminated
+        };
+
+        explicit RealtimeTranscriber(openai::Message& message) : RealtimeTranscriber(message, Options{}) {}
+
+        RealtimeTranscriber(openai::Message& message, Options options)
+            : message_{ message }, options_{ std::move(options) }, audio_{ static_cast<size_t>(options_.sampleRate) * 10 } {}
+
+        ~RealtimeTranscriber() {
+            stop();
+        }
+
+        RealtimeTranscriber(const RealtimeTranscriber&) = delete;
+        RealtimeTranscriber& operator=(const RealtimeTranscriber&) = delete;
+
+        /// @brief Open the websocket with a temporary token and start the network thread
+        /// @return false if the connection could not be established
+        bool connect(const std::string& token) {
+            stop();
+            curl_ = curl_easy_init();
+            if (!curl_) {
+                return false;
+            }
+            std::string url = constructWebSocketUrl(options_.sampleRate, options_.wordBoost) + "&token=" + token;
+            curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl_, CURLOPT_CONNECT_ONLY, 2L); // Websocket mode: upgrade, then curl_ws_send/recv
+            curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(options_.connectTimeout.count()));
+            auto begin = std::chrono::steady_clock::now();
+            CURLcode result = curl_easy_perform(curl_);
+            connectStatus_ = 0;
+            curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &connectStatus_);
+            if (result != CURLE_OK) {
+                OPENAI_LOG_ERROR("realtime_connect_failed", "HTTP %ld: %s", connectStatus_, curl_easy_strerror(result));
+                curl_easy_cleanup(curl_);
+                curl_ = nullptr;
+                return false;
+            }
+
+            connectMicros_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+            connected_ = true;
+            stopping_ = false;
+            terminated_ = false;
+            samplesPushed_ = 0;
+            network_ = std::thread([this] { run(); });
+            return true;
+        }
+
+        /// @brief Open the websocket with the token cached by `tokens`
+        ///
+        /// Only waits for the token API if the manager has no usable token yet, e.g. right after it was
+        /// created. A token the server rejects is invalidated and the connection retried once.
+        bool connect(TokenManager& tokens) {
+            auto begin = std::chrono::steady_clock::now();
+            std::string token;
+            if (!tokens.tryGet(token)) {
+                OPENAI_LOG_WARN("realtime_token_wait", "No cached token; waiting for the token API");
+                token = tokens.get(options_.connectTimeout);
+            }
+            tokenWaitMicros_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+            if (token.empty()) {
+                fail("No realtime token");
+                return false;
+            }
+            if (connect(token)) {
+                return true;
+            }
+            if (connectStatus_ != 401 && connectStatus_ != 403) {
+                return false;
+            }
+            tokens.invalidate(token);
+            token = tokens.get(options_.connectTimeout);
+            return !token.empty() && connect(token);
+        }
+
+        /// @brief Connect and start capturing from `source`
+        bool start(const std::string& token, openai::AudioSource& source) {
+            return connect(token) && startCapture(source);
+        }
+
+        /// @brief Connect with a token cached by `tokens` and start capturing from `source`
+        bool start(TokenManager& tokens, openai::AudioSource& source) {
+            return connect(tokens) && startCapture(source);
+        }
+
+        /// @brief Start capturing from `source` on an open connection
+        bool startCapture(openai::AudioSource& source) {
+            source_ = &source;
+            if (!source.start(openai::StreamFormat{ 1, static_cast<double>(options_.sampleRate), options_.framesPerBuffer },
+                    &RealtimeTranscriber::captureCallback, this)) {
+                source_ = nullptr;
+                stop();
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief Stop capturing, upload what is left, end the session and wait for its last transcript
+        void stop() {
+            if (source_) {
+                source_->stop();
+                source_ = nullptr;
+            }
+            stopping_ = true;
+            if (network_.joinable()) {
+                network_.join();
+            }
+            if (curl_) {
+                curl_easy_cleanup(curl_);
+                curl_ = nullptr;
+            }
+            connected_ = false;
+        }
+
+        /// @brief Queue captured mono samples in [-1, 1] for upload (one capture thread; real-time safe)
+        void pushAudio(const float* samples, size_t count) {
+            long long now = nanosNow();
+            size_t written = audio_.write(samples, count);
+            droppedSamples_.fetch_add(count - written, std::memory_order_relaxed);
+            size_t end = samplesPushed_.fetch_add(written, std::memory_order_relaxed) + written;
+            pushMark(end, now);
+        }
+
+        /// @brief Ask the service to finalize the current utterance now, e.g. at the end of a VAD segment
+        void forceEndUtterance() {
+            forceEnd_ = true;
+        }
+
+        /// @brief PaStreamCallback for an AudioSource: forwards every captured buffer to pushAudio()
+        static int captureCallback(const void* inputBuffer, void*, unsigned long frames,
+            const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void* userData) {
+            auto* self = static_cast<RealtimeTranscriber*>(userData);
+            if (inputBuffer) {
+                self->pushAudio(static_cast<const float*>(inputBuffer), frames);
+            }
+            return self->stopping_ ? paComplete : paContinue;
+        }
+
+        bool isConnected() const { return connected_ && !terminated_; }
+
+        const Options& options() const { return options_; }
+
+        /// @brief Capture-to-partial latency of every non-empty PartialTranscript
+        const openai::LatencyHistogram& partialLatency() const { return partialLatency_; }
+
+        /// @brief Capture-to-final latency of every non-empty FinalTranscript
+        const openai::LatencyHistogram& finalLatency() const { return finalLatency_; }
+
+        nlohmann::json toJson() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return nlohmann::json{
+                {"session_id", sessionId_},
+                {"sample_rate", options_.sampleRate},
+                {"frames_sent", framesSent_.load()},
+                {"bytes_sent", bytesSent_.load()},
+                {"dropped_samples", droppedSamples_.load()},
+                {"partials", partials_.load()},
+                {"finals", finals_.load()},
+                {"error", error_},
+                {"token_wait_ms", tokenWaitMicros_.load() / 1e3},
+                {"connect_ms", connectMicros_.load() / 1e3},
+                {"capture_to_partial", partialLatency_.toJson()},
+                {"capture_to_final", finalLatency_.toJson()}
+            };
+        }
+
+    private:
+        /// @brief End of a captured block: sample index in the stream and when it was captured
+        struct CaptureMark {
+            size_t endSample;
+            long long nanos;
+        };
+
+        static constexpr size_t MARK_SLOTS = 256; ///< Capture blocks in flight to the network thread, a power of two
+        static constexpr size_t MARK_HORIZON_SECONDS = 30; ///< Results about older audio are not timed
+
+        static long long nanosNow() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void pushMark(size_t endSample, long long nanos) {
+            size_t head = markHead_.load(std::memory_order_relaxed);
+            if (head - markTail_.load(std::memory_order_acquire) >= MARK_SLOTS) {
+                return; // Latency gets coarser, nothing else is affected
+            }
+            marks_[head & (MARK_SLOTS - 1)] = CaptureMark{ endSample, nanos };
+            markHead_.store(head + 1, std::memory_order_release);
+        }
+
+        /// @brief Network thread: upload frames, handle results, then terminate the session
+        void run() {
+            const size_t frameSamples = static_cast<size_t>(options_.sampleRate * options_.frameDuration.count() / 1000);
+            std::vector<float> samples(frameSamples);
+            std::string frame(frameSamples * 2, '\0');
+            size_t samplesSent = 0;
+            bool terminateSent = false;
+            auto deadline = std::chrono::steady_clock::now();
+
+            while (true) {
+                bool stopping = stopping_.load();
+                bool endUtterance = forceEnd_.load(); // Read first: the audio it ends was pushed before it was set
+                while (audio_.size() >= frameSamples || ((stopping || endUtterance) && !terminateSent && !audio_.isEmpty())) {
+                    size_t n = audio_.read(samples.data(), frameSamples);
+                    std::fill(samples.begin() + n, samples.end(), 0.0f); // Pad the last frame to the minimum length
+                    if (n < frameSamples) {
+                        samplesPushed_.fetch_add(frameSamples - n, std::memory_order_relaxed); // Keep later marks on the service's timeline
+                    }
+                    for (size_t i = 0; i < frameSamples; ++i) {
+                        int16_t value = static_cast<int16_t>(std::lrint(std::clamp(samples[i], -1.0f, 1.0f) * 32767.0f));
+                        frame[2 * i] = static_cast<char>(value & 0xFF);
+                        frame[2 * i + 1] = static_cast<char>((value >> 8) & 0xFF);
+                    }
+                    if (!send(frame, CURLWS_BINARY)) {
+                        connected_ = false;
+                        return;
+                    }
+                    samplesSent += frameSamples;
+                    framesSent_ += 1;
+                    bytesSent_ += frame.size();
+                    collectMarks(samplesSent);
+                }
+
+                if (endUtterance && forceEnd_.exchange(false) && !send(R"({"force_end_utterance":true})", CURLWS_TEXT)) {
+                    connected_ = false;
+                    return;
+                }
+                if (stopping && !terminateSent) {
+                    if (!send(R"({"terminate_session":true})", CURLWS_TEXT)) {
+                        connected_ = false;
+                        return;
+                    }
+                    terminateSent = true;
+                    deadline = std::chrono::steady_clock::now() + options_.closeTimeout;
+                }
+
+                if (!receive() || terminated_ || (terminateSent && std::chrono::steady_clock::now() >= deadline)) {
+                    break;
+                }
+                waitForSocket(false, 5);
+            }
+            connected_ = false;
+        }
+
+        /// @brief Move the capture marks to the network thread's own list, forgetting those too old to be reported
+        void collectMarks(size_t samplesSent) {
+            size_t tail = markTail_.load(std::memory_order_relaxed);
+            size_t head = markHead_.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                sentMarks_.push_back(marks_[tail & (MARK_SLOTS - 1)]);
+            }
+            markTail_.store(tail, std::memory_order_release);
+            const size_t horizon = static_cast<size_t>(options_.sampleRate) * MARK_HORIZON_SECONDS;
+            while (!sentMarks_.empty() && sentMarks_.front().endSample + horizon < samplesSent) {
+                sentMarks_.pop_front();
+            }
+        }
+
+        /// @brief Record how long after its capture the audio ending at `audioEndMs` was transcribed
+        void recordLatency(long long audioEndMs, openai::LatencyHistogram& histogram) {
+            size_t endSample = static_cast<size_t>(audioEndMs * options_.sampleRate / 1000);
+            for (const CaptureMark& mark : sentMarks_) {
+                if (mark.endSample >= endSample) {
+                    histogram.recordNanos(nanosNow() - mark.nanos);
+                    return;
+                }
+            }
+        }
+
+        /// @brief Send one complete websocket message
+        bool send(const std::string& payload, unsigned int flags) {
+            size_t offset = 0;
+            while (offset < payload.size()) {
+                size_t sent = 0;
+                CURLcode result = curl_ws_send(curl_, payload.data() + offset, payload.size() - offset, &sent, 0, flags);
+                if (result == CURLE_AGAIN) {
+                    waitForSocket(true, 100);
+                    continue;
+                }
+                if (result != CURLE_OK) {
+                    fail(std::string("Send failed: ") + curl_easy_strerror(result));
+                    return false;
+                }
+                offset += sent;
+            }
+            return true;
+        }
+
+        /// @brief Handle every message that has arrived
+        /// @return false once the connection is closed
+        bool receive() {
+            char buffer[16384];
+            while (true) {
+                size_t received = 0;
+                struct curl_ws_frame* meta = nullptr;
+                CURLcode result = curl_ws_recv(curl_, buffer, sizeof(buffer), &received, &meta);
+                if (result == CURLE_AGAIN) {
+                    return true;
+                }
+                if (result != CURLE_OK) {
+                    if (!terminated_) {
+                        fail(std::string("Receive failed: ") + curl_easy_strerror(result));
+                    }
+                    return false;
+                }
+                if (meta->flags & CURLWS_CLOSE) {
+                    return false;
+                }
+                if (meta->flags & (CURLWS_TEXT | CURLWS_CONT)) {
+                    incoming_.append(buffer, received);
+                    if (meta->bytesleft == 0 && !(meta->flags & CURLWS_CONT)) {
+                        handleMessage(incoming_);
+                        incoming_.clear();
+                    }
+                }
+            }
+        }
+
+        void handleMessage(const std::string& text) {
+            nlohmann::json message = nlohmann::json::parse(text, nullptr, false);
+            if (!message.is_object()) {
+                OPENAI_LOG_WARN("realtime_invalid_message", "%s", text.c_str());
+                return;
+            }
+            if (message.contains("error")) {
+                fail(message["error"].is_string() ? message["error"].get<std::string>() : message["error"].dump());
+                return;
+            }
+
+            std::string type = message.value("message_type", "");
+            std::string transcript = message.value("text", "");
+            if (type == "PartialTranscript") {
+                message_.setPartialTranscript(transcript);
+                if (!transcript.empty()) {
+                    partials_ += 1;
+                    recordLatency(message.value("audio_end", 0LL), partialLatency_);
+                }
+            }
+            else if (type == "FinalTranscript") {
+                if (!transcript.empty()) {
+                    message_.setFinalTranscript(message_.receivedFinal() ? " " + transcript : transcript);
+                    finals_ += 1;
+                    recordLatency(message.value("audio_end", 0LL), finalLatency_);
+                }
+            }
+            else if (type == "SessionBegins") {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sessionId_ = message.value("session_id", "");
+            }
+            else if (type == "SessionTerminated") {
+                terminated_ = true;
+            }
+        }
+
+        void fail(const std::string& error) {
+            OPENAI_LOG_ERROR("realtime_session_failed", "%s", error.c_str());
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = error;
+        }
+
+        /// @brief Wait until the websocket is readable (or writable) or `timeoutMs` passes
+        void waitForSocket(bool forWrite, long timeoutMs) {
+            curl_socket_t socket = CURL_SOCKET_BAD;
+            if (curl_easy_getinfo(curl_, CURLINFO_ACTIVESOCKET, &socket) != CURLE_OK || socket == CURL_SOCKET_BAD) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+                return;
+            }
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(socket, &set);
+            timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+            select(static_cast<int>(socket + 1), forWrite ? nullptr : &set, forWrite ? &set : nullptr, nullptr, &timeout);
+        }
+
+        openai::Message& message_; ///< Receives the partial and final transcripts
+        Options options_;
+        CURL* curl_{ nullptr }; ///< Websocket connection, used by the network thread only while it runs
+        openai::AudioSource* source_{ nullptr }; ///< Source started by start(), if any
+        std::thread network_; ///< Runs run()
+
+        openai::AudioBuffer audio_; ///< Captured samples waiting for upload (capture thread -> network thread)
+        std::atomic<size_t> samplesPushed_{ 0 };
+        std::array<CaptureMark, MARK_SLOTS> marks_{}; ///< Capture times of pushed blocks (capture thread -> network thread)
+        std::atomic<size_t> markHead_{ 0 };
+        std::atomic<size_t> markTail_{ 0 };
+        std::deque<CaptureMark> sentMarks_; ///< Capture times of uploaded blocks (network thread)
+        std::string incoming_; ///< Text message being reassembled (network thread)
+
+        long connectStatus_{ 0 }; ///< HTTP status of the last upgrade attempt
+        std::atomic<long long> connectMicros_{ 0 }; ///< Duration of the last successful upgrade
+        std::atomic<long long> tokenWaitMicros_{ 0 }; ///< Time connect(TokenManager&) spent getting a token
+        std::atomic<bool> connected_{ false };
+        std::atomic<bool> stopping_{ false };
+        std::atomic<bool> terminated_{ false }; ///< SessionTerminated was received
+        std::atomic<bool> forceEnd_{ false };
+
+        std::atomic<size_t> framesSent_{ 0 };
+        std::atomic<size_t> bytesSent_{ 0 };
+        std::atomic<size_t> droppedSamples_{ 0 }; ///< Samples lost because the upload fell 10 s behind
+        std::atomic<size_t> partials_{ 0 };
+        std::atomic<size_t> finals_{ 0 };
+        openai::LatencyHistogram partialLatency_;
+        openai::LatencyHistogram finalLatency_;
+
+        mutable std::mutex mutex_; ///< Protects sessionId_ and error_
+        std::string sessionId_;
+        std::string error_;
+    };
+
+} // namespace assemblyai
+
+#endif // REALTIME_TRANSCRIBER_HPP_
@@ -0,0 +1,355 @@
+#ifndef REQUEST_ENGINE_HPP_
+#define REQUEST_ENGINE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "connection_pool.hpp"
+#include "logger.hpp"
+
+namespace openai {
+
+    /// @brief Description of one HTTP POST to run on the RequestEngine
+    struct Request {
+        std::string url; ///< The url to make the request to
+        std::string body; ///< The body of the request to send
+        std::vector<std::string> headers; ///< Extra request headers ("Name: value")
+        std::chrono::milliseconds timeout{ 0 }; ///< Whole-transfer timeout, 0 for none
+
+        /// @brief Called on the I/O thread once the transfer has been handed to curl
+        std::function<void()> onStart;
+
+        /// @brief Called on the I/O thread for every received chunk of a 2xx response; return false to abort
+        /// the transfer. The body of an error response is logged instead.
+        std::function<bool(const char* data, size_t size)> onData;
+
+        /// @brief Called on the I/O thread once the transfer finished, failed, timed out or was cancelled
+        std::function<void(CURLcode result, long httpStatus)> onComplete;
+    };
+
+    class RequestEngine;
+
+    /// @brief Whether `httpStatus` is a 2xx response
+    inline bool isHttpSuccess(long httpStatus) {
+        return httpStatus >= 200 && httpStatus < 300;
+    }
+
+    /**
+    * @brief An in-flight transfer owned by the RequestEngine
+    *
+    * Returned by RequestEngine::submit(); can be waited on from any thread and cancelled at any time.
+    */
+    class Transfer {
+    public:
+        explicit Transfer(Request request) : request_{ std::move(request) } {}
+
+        /// @brief A transfer that is already finished, for responses served without the network
+        static std::shared_ptr<Transfer> completed(CURLcode result = CURLE_OK, long httpStatus = 200) {
+            auto transfer = std::make_shared<Transfer>(Request{});
+            transfer->finished_ = true;
+            transfer->result_ = result;
+            transfer->httpStatus_ = httpStatus;
+            return transfer;
+        }
+
+        Transfer(const Transfer&) = delete;
+        Transfer& operator=(const Transfer&) = delete;
+
+        /// @brief Abort the transfer; onComplete is called with CURLE_ABORTED_BY_CALLBACK
+        void cancel();
+
+        /// @brief Block until the transfer completes
+        /// @return true if the transfer succeeded with a 2xx response
+        bool wait() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return finished_; });
+            return result_ == CURLE_OK && isHttpSuccess(httpStatus_);
+        }
+
+        /// @brief Block until the transfer completes or `timeout` elapses
+        /// @return true if the transfer has finished
+        bool waitFor(std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return cv_.wait_for(lock, timeout, [this] { return finished_; });
+        }
+
+        bool finished() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return finished_;
+        }
+
+        bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+        CURLcode result() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return result_;
+        }
+
+        long httpStatus() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return httpStatus_;
+        }
+
+    private:
+        friend class RequestEngine;
+
+        Request request_; ///< The request being performed
+        RequestEngine* engine_{ nullptr }; ///< Engine running the transfer
+        CURL* curl_{ nullptr }; ///< Pooled easy handle, owned by the I/O thread while active
+        curl_slist* headers_{ nullptr }; ///< Header list, freed on completion
+        std::atomic<bool> cancelled_{ false }; ///< Set by cancel()
+        std::string errorBody_; ///< Start of a non-2xx response body, kept for the log (I/O thread only)
+
+        mutable std::mutex mutex_; ///< Protects the completion state below
+        std::condition_variable cv_; ///< Signalled on completion
+        bool finished_{ false };
+        CURLcode result_{ CURLE_OK };
+        long httpStatus_{ 0 };
+    };
+
+    using RequestHandle = std::shared_ptr<Transfer>;
+
+    /**
+    * @brief Event-driven HTTP engine running every transfer on one curl multi handle
+    *
+    * A single I/O thread drives all transfers, so a streaming chat completion and any number of speech
+    * requests progress concurrently, multiplexed over shared HTTP/2 connections from the ConnectionPool.
+    */
+    class RequestEngine {
+    public:
+        /// @brief Get the engine shared by the whole process
+        static RequestEngine& instance() {
+            static RequestEngine engine;
+            return engine;
+        }
+
+        RequestEngine(const RequestEngine&) = delete;
+        RequestEngine& operator=(const RequestEngine&) = delete;
+
+        /// @brief Queue a request; it starts on the next I/O loop iteration
+        RequestHandle submit(Request request) {
+            auto transfer = std::make_shared<Transfer>(std::move(request));
+            transfer->engine_ = this;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_.push_back(transfer);
+            }
+            curl_multi_wakeup(multi_);
+            return transfer;
+        }
+
+        /// @brief Number of transfers currently running on the multi handle
+        size_t activeTransfers() const { return activeCount_.load(std::memory_order_relaxed); }
+
+    private:
+        friend class Transfer;
+
+        RequestEngine() : pool_{ ConnectionPool::instance() } {
+            multi_ = curl_multi_init();
+            curl_multi_setopt(multi_, CURLMOPT_PIPELINING, static_cast<long>(CURLPIPE_MULTIPLEX));
+            ioThread_ = std::thread([this] { run(); });
+        }
+
+        ~RequestEngine() {
+            running_ = false;
+            curl_multi_wakeup(multi_);
+            if (ioThread_.joinable()) {
+                ioThread_.join();
+            }
+            curl_multi_cleanup(multi_);
+        }
+
+        void requestCancel() {
+            cancelRequested_ = true;
+            curl_multi_wakeup(multi_);
+        }
+
+        /// @brief I/O loop: start queued transfers, service sockets and dispatch completions
+        void run() {
+            while (running_) {
+                startPending();
+                if (cancelRequested_.exchange(false)) {
+                    removeCancelled();
+                }
+
+                int stillRunning = 0;
+                curl_multi_perform(multi_, &stillRunning);
+
+                int queued = 0;
+                while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+                    if (msg->msg != CURLMSG_DONE) {
+                        continue;
+                    }
+                    auto it = active_.find(msg->easy_handle);
+                    if (it == active_.end()) {
+                        continue;
+                    }
+                    RequestHandle transfer = it->second;
+                    CURLcode result = transfer->cancelled() ? CURLE_ABORTED_BY_CALLBACK : msg->data.result;
+                    finish(transfer, result);
+                }
+
+                curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+            }
+
+            // Shutting down: abort whatever is left
+            startPending();
+            std::vector<RequestHandle> remaining;
+            for (auto& entry : active_) {
+                remaining.push_back(entry.second);
+            }
+            for (auto& transfer : remaining) {
+                finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+            }
+        }
+
+        void startPending() {
+            std::vector<RequestHandle> pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending.swap(pending_);
+            }
+            for (auto& transfer : pending) {
+                if (transfer->cancelled()) {
+                    complete(transfer, CURLE_ABORTED_BY_CALLBACK, 0);
+                    continue;
+                }
+                CURL* curl = pool_.acquire();
+                if (curl == nullptr) {
+                    complete(transfer, CURLE_FAILED_INIT, 0);
+                    continue;
+                }
+                transfer->curl_ = curl;
+
+                const Request& request = transfer->request_;
+                for (const auto& header : request.headers) {
+                    transfer->headers_ = curl_slist_append(transfer->headers_, header.c_str());
+                }
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers_);
+                curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.length()));
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.data());
+                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+                curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer.get());
+                if (request.timeout.count() > 0) {
+                    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(request.timeout.count()));
+                }
+
+                active_[curl] = transfer;
+                activeCount_ = active_.size();
+                curl_multi_add_handle(multi_, curl);
+                if (request.onStart) {
+                    request.onStart();
+                }
+            }
+        }
+
+        void removeCancelled() {
+            std::vector<RequestHandle> cancelled;
+            for (auto& entry : active_) {
+                if (entry.second->cancelled()) {
+                    cancelled.push_back(entry.second);
+                }
+            }
+            for (auto& transfer : cancelled) {
+                finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+            }
+        }
+
+        /// @brief Detach a running transfer from the multi handle and complete it
+        void finish(const RequestHandle& transfer, CURLcode result) {
+            CURL* curl = transfer->curl_;
+            long httpStatus = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+            curl_multi_remove_handle(multi_, curl);
+            active_.erase(curl);
+            activeCount_ = active_.size();
+
+            pool_.release(curl);
+            transfer->curl_ = nullptr;
+            curl_slist_free_all(transfer->headers_);
+            transfer->headers_ = nullptr;
+
+            if (result == CURLE_OK && !isHttpSuccess(httpStatus)) {
+                OPENAI_LOG_ERROR("http_error", "%s returned HTTP %ld: %s", transfer->request_.url.c_str(), httpStatus,
+                    transfer->errorBody_.c_str());
+            }
+            transfer->errorBody_.clear();
+
+            complete(transfer, result, httpStatus);
+        }
+
+        void complete(const RequestHandle& transfer, CURLcode result, long httpStatus) {
+            if (result != CURLE_OK && result != CURLE_ABORTED_BY_CALLBACK) {
+                OPENAI_LOG_ERROR("transfer_failed", "%s %s", transfer->request_.url.c_str(), curl_easy_strerror(result));
+            }
+            if (transfer->request_.onComplete) {
+                transfer->request_.onComplete(result, httpStatus);
+            }
+            {
+                std::lock_guard<std::mutex> lock(transfer->mutex_);
+                transfer->finished_ = true;
+                transfer->result_ = result;
+                transfer->httpStatus_ = httpStatus;
+            }
+            transfer->cv_.notify_all();
+        }
+
+        static size_t writeCallback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+            Transfer* transfer = static_cast<Transfer*>(userdata);
+            size_t realsize = size * nmemb;
+            if (transfer->cancelled()) {
+                return 0; // Abort the transfer
+            }
+            long httpStatus = 0;
+            curl_easy_getinfo(transfer->curl_, CURLINFO_RESPONSE_CODE, &httpStatus);
+            if (!isHttpSuccess(httpStatus)) {
+                // An error payload (JSON from the API) must not reach the decoder or the SSE parser
+                size_t keep = std::min(realsize, MAX_ERROR_BODY - std::min(MAX_ERROR_BODY, transfer->errorBody_.size()));
+                transfer->errorBody_.append(static_cast<const char*>(ptr), keep);
+                return realsize;
+            }
+            if (transfer->request_.onData && !transfer->request_.onData(static_cast<const char*>(ptr), realsize)) {
+                return 0;
+            }
+            return realsize;
+        }
+
+        static constexpr size_t MAX_ERROR_BODY = 4096; ///< Bytes of an error response kept for the log
+
+        ConnectionPool& pool_; ///< Source of easy handles (constructed first, destroyed last)
+        CURLM* multi_{ nullptr }; ///< Multi handle driving every transfer
+        std::thread ioThread_; ///< The single I/O thread
+        std::atomic<bool> running_{ true };
+        std::atomic<bool> cancelRequested_{ false }; ///< Set when some transfer asked to be cancelled
+
+        std::mutex mutex_; ///< Protects pending_
+        std::vector<RequestHandle> pending_; ///< Submitted but not yet added to the multi handle
+
+        std::unordered_map<CURL*, RequestHandle> active_; ///< Running transfers (I/O thread only)
+        std::atomic<size_t> activeCount_{ 0 };
+    };
+
+    inline void Transfer::cancel() {
+        if (cancelled_.exchange(true)) {
+            return;
+        }
+        if (engine_) {
+            engine_->requestCancel();
+        }
+    }
+
+} // namespace openai
+
+#endif // REQUEST_ENGINE_HPP_
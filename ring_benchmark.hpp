@@ -0,0 +1,160 @@
+#ifndef RING_BENCHMARK_HPP_
+#define RING_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "openai-reduced.hpp"
+
+namespace openai {
+
+    namespace detail {
+
+        /// @brief The AudioBuffer this project used before the SPSC ring: one float per queue node behind a mutex
+        class LockedQueueBuffer {
+        public:
+            size_t write(const float* data, size_t count) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (size_t i = 0; i < count; ++i) {
+                    buffer_.push(data[i]);
+                }
+                return count;
+            }
+
+            size_t getData(float* output, size_t framesPerBuffer) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                size_t i = 0;
+                for (; i < framesPerBuffer && !buffer_.empty(); ++i) {
+                    output[i] = buffer_.front();
+                    buffer_.pop();
+                }
+                return i;
+            }
+
+        private:
+            std::queue<float> buffer_;
+            std::mutex mutex_;
+        };
+
+        /// @brief Result of streaming one response through a buffer
+        struct RingRun {
+            double samplesPerSecond; ///< Samples moved from producer to consumer per second of wall time
+            double medianCallbackNs; ///< Median duration of one consumer read
+            double p99CallbackNs;
+            double maxCallbackNs; ///< Worst consumer read, what a PortAudio callback would have to absorb
+        };
+
+        /// @brief Push `total` samples from a decoder-like producer thread in `chunkSize` pieces while this
+        /// thread drains them `framesPerBuffer` at a time like the playback callback, without pausing
+        template <typename Buffer>
+        RingRun streamThrough(Buffer& buffer, size_t total, size_t chunkSize, size_t framesPerBuffer) {
+            std::vector<float> chunk(chunkSize, 0.25f);
+            std::vector<float> output(framesPerBuffer);
+            std::vector<double> callbackNs;
+            callbackNs.reserve(total / framesPerBuffer * 4);
+            std::atomic<bool> start{ false };
+
+            std::thread producer([&] {
+                while (!start.load(std::memory_order_acquire)) {}
+                size_t written = 0;
+                while (written < total) {
+                    size_t n = std::min(chunkSize, total - written);
+                    size_t done = 0;
+                    while (done < n) {
+                        size_t accepted = buffer.write(chunk.data() + done, n - done);
+                        done += accepted;
+                        if (accepted == 0) {
+                            std::this_thread::yield(); // Ring full
+                        }
+                    }
+                    written += n;
+                }
+            });
+
+            auto begin = std::chrono::steady_clock::now();
+            start.store(true, std::memory_order_release);
+            size_t read = 0;
+            while (read < total) {
+                auto callbackBegin = std::chrono::steady_clock::now();
+                size_t n = buffer.getData(output.data(), framesPerBuffer);
+                auto callbackEnd = std::chrono::steady_clock::now();
+                callbackNs.push_back(std::chrono::duration<double, std::nano>(callbackEnd - callbackBegin).count());
+                read += n;
+            }
+            auto elapsed = std::chrono::steady_clock::now() - begin;
+            producer.join();
+
+            std::sort(callbackNs.begin(), callbackNs.end());
+            return RingRun{
+                total / std::chrono::duration<double>(elapsed).count(),
+                callbackNs[callbackNs.size() / 2],
+                callbackNs[callbackNs.size() * 99 / 100],
+                callbackNs.back()
+            };
+        }
+
+        /// @brief Median throughput and callback time over `runs` runs, worst callback over all of them
+        template <typename Buffer>
+        nlohmann::json benchmarkBuffer(size_t runs, size_t total, size_t chunkSize, size_t framesPerBuffer) {
+            std::vector<RingRun> results;
+            for (size_t run = 0; run < runs; ++run) {
+                Buffer buffer;
+                results.push_back(streamThrough(buffer, total, chunkSize, framesPerBuffer));
+            }
+            auto median = [&](double RingRun::* field) {
+                std::vector<double> values;
+                for (const auto& result : results) {
+                    values.push_back(result.*field);
+                }
+                std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+                return values[values.size() / 2];
+            };
+            double worst = 0.0;
+            for (const auto& result : results) {
+                worst = std::max(worst, result.maxCallbackNs);
+            }
+            return nlohmann::json{
+                {"samples_per_second", median(&RingRun::samplesPerSecond)},
+                {"median_callback_ns", median(&RingRun::medianCallbackNs)},
+                {"p99_callback_ns", median(&RingRun::p99CallbackNs)},
+                {"max_callback_ns", worst}
+            };
+        }
+
+    } // namespace detail
+
+    /**
+    * @brief Compare the old mutex-protected std::queue audio buffer with the lock-free SPSC AudioBuffer
+    *
+    * Each run streams a minute of 24 kHz audio from a producer thread writing 20 ms Opus frames to a
+    * consumer reading one PortAudio buffer at a time as fast as it can, so both sides contend for the
+    * whole run. "max_callback_ns" is the worst single read, which is what can make playback glitch.
+    */
+    inline int ring_benchmark_main(size_t framesPerBuffer = 256) {
+        const size_t runs = 5;
+        const size_t total = static_cast<size_t>(SAMPLE_RATE) * 60;
+        const size_t chunkSize = static_cast<size_t>(SAMPLE_RATE) / 50;
+
+        nlohmann::json result{
+            {"samples", total},
+            {"chunk_samples", chunkSize},
+            {"frames_per_buffer", framesPerBuffer},
+            {"runs", runs},
+            {"mutex_queue", detail::benchmarkBuffer<detail::LockedQueueBuffer>(runs, total, chunkSize, framesPerBuffer)},
+            {"spsc_ring", detail::benchmarkBuffer<AudioBuffer>(runs, total, chunkSize, framesPerBuffer)}
+        };
+        std::cout << "Ring benchmark: " << result.dump(2) << std::endl;
+        return 0;
+    }
+
+} // namespace openai
+
+#endif // RING_BENCHMARK_HPP_
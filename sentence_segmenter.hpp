@@ -0,0 +1,147 @@
+#ifndef SENTENCE_SEGMENTER_HPP_
+#define SENTENCE_SEGMENTER_HPP_
+
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace openai {
+
+    /**
+    * @brief Incrementally cuts streamed text into speakable segments
+    *
+    * Text is cut after sentence punctuation followed by whitespace once a segment has at least
+    * `minLength` characters, after clause punctuation once it has `clauseLength` characters, and at
+    * the last space once it exceeds `maxLength`. A boundary is only confirmed once the character
+    * after it has arrived, so "3.5" or a sentence split across deltas is never cut early.
+    */
+    class SentenceSegmenter {
+    public:
+        SentenceSegmenter(size_t minLength = 16, size_t clauseLength = 120, size_t maxLength = 300)
+            : minLength_{ minLength }, clauseLength_{ clauseLength }, maxLength_{ maxLength } {}
+
+        /// @brief Append streamed text
+        /// @return Segments completed by this text, in order
+        std::vector<std::string> push(std::string_view text) {
+            std::vector<std::string> segments;
+            pending_.append(text.data(), text.size());
+
+            size_t i = scanned_;
+            while (i + 1 < pending_.size()) {
+                size_t end = boundaryAfter(i);
+                if (end != std::string::npos) {
+                    emit(end, segments);
+                    i = scanned_;
+                    continue;
+                }
+                if (i >= maxLength_) {
+                    size_t space = pending_.rfind(' ', i);
+                    emit(space != std::string::npos && space > 0 ? space : i, segments);
+                    i = scanned_;
+                    continue;
+                }
+                ++i;
+            }
+            scanned_ = i;
+            return segments;
+        }
+
+        /// @brief Return whatever text is left once the stream has ended
+        std::string flush() {
+            std::string rest = trim(pending_);
+            pending_.clear();
+            scanned_ = 0;
+            return rest;
+        }
+
+        /// @brief Split a complete text into segments
+        static std::vector<std::string> split(const std::string& text, size_t minLength = 16, size_t clauseLength = 120, size_t maxLength = 300) {
+            SentenceSegmenter segmenter{ minLength, clauseLength, maxLength };
+            std::vector<std::string> segments = segmenter.push(text);
+            std::string rest = segmenter.flush();
+            if (!rest.empty()) {
+                segments.push_back(rest);
+            }
+            return segments;
+        }
+
+    private:
+        /// @brief If position `i` ends a segment, return the length of that segment, npos otherwise
+        size_t boundaryAfter(size_t i) const {
+            char c = pending_[i];
+            if (c == '\n') {
+                return i + 1 >= minLength_ ? i + 1 : std::string::npos;
+            }
+
+            bool sentence = c == '.' || c == '!' || c == '?';
+            bool clause = c == ',' || c == ';' || c == ':';
+            if (!sentence && !clause) {
+                return std::string::npos;
+            }
+
+            // Keep closing quotes and brackets with the sentence they end
+            size_t end = i + 1;
+            while (end < pending_.size() && (pending_[end] == '"' || pending_[end] == '\'' || pending_[end] == ')' || pending_[end] == ']')) {
+                ++end;
+            }
+            if (end >= pending_.size() || !std::isspace(static_cast<unsigned char>(pending_[end]))) {
+                return std::string::npos;
+            }
+
+            if (sentence && end >= minLength_ && !(c == '.' && isAbbreviation(i))) {
+                return end;
+            }
+            if (end >= clauseLength_) {
+                return end;
+            }
+            return std::string::npos;
+        }
+
+        /// @brief Whether the '.' at `dot` ends an abbreviation or initial rather than a sentence
+        bool isAbbreviation(size_t dot) const {
+            size_t start = dot;
+            while (start > 0 && std::isalpha(static_cast<unsigned char>(pending_[start - 1]))) {
+                --start;
+            }
+            std::string word = pending_.substr(start, dot - start);
+            if (word.size() == 1) {
+                return true; // Initials and "e.g." / "i.e."
+            }
+            static const char* abbreviations[] = { "Mr", "Mrs", "Ms", "Dr", "St", "Jr", "Sr", "vs", "etc", "approx", "No" };
+            for (const char* abbreviation : abbreviations) {
+                if (word == abbreviation) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void emit(size_t length, std::vector<std::string>& segments) {
+            std::string segment = trim(pending_.substr(0, length));
+            pending_.erase(0, length);
+            scanned_ = 0;
+            if (!segment.empty()) {
+                segments.push_back(std::move(segment));
+            }
+        }
+
+        static std::string trim(const std::string& text) {
+            size_t begin = text.find_first_not_of(" \t\r\n");
+            if (begin == std::string::npos) {
+                return "";
+            }
+            size_t end = text.find_last_not_of(" \t\r\n");
+            return text.substr(begin, end - begin + 1);
+        }
+
+        size_t minLength_; ///< Shortest segment cut at a sentence boundary
+        size_t clauseLength_; ///< Shortest segment cut at a clause boundary
+        size_t maxLength_; ///< Longest segment before cutting at a space
+        std::string pending_; ///< Text not yet emitted
+        size_t scanned_{ 0 }; ///< Position in pending_ up to which boundaries were already checked
+    };
+
+} // namespace openai
+
+#endif // SENTENCE_SEGMENTER_HPP_
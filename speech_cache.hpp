@@ -0,0 +1,297 @@
+#ifndef SPEECH_CACHE_HPP_
+#define SPEECH_CACHE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /**
+    * @brief Persistent, size-bounded cache of synthesized audio keyed by the speech request body
+    *
+    * The request JSON (input, model, voice, response_format, speed) is hashed into the file name and
+    * also stored inside the entry, so a hash collision is detected and treated as a miss. Entries are
+    * written to a temporary file, flushed to disk and renamed into place, and on POSIX the directory is
+    * synced after the rename, so a crash never leaves a truncated entry behind or loses a stored one. The least recently used entries are evicted once the cache exceeds
+    * `maxBytes`; access times are kept in the file modification time so the order survives restarts.
+    */
+    class SpeechCache {
+    public:
+        /// @brief Hit/miss counters
+        struct Stats {
+            size_t hits;
+            size_t misses;
+            size_t stores;
+            size_t evictions;
+            size_t bytes; ///< Current size of the cache on disk
+            size_t entries;
+        };
+
+        SpeechCache(const std::filesystem::path& directory, size_t maxBytes = 256 * 1024 * 1024)
+            : directory_{ directory }, maxBytes_{ maxBytes } {
+            std::error_code ec;
+            std::filesystem::create_directories(directory_, ec);
+            loadIndex();
+        }
+
+        SpeechCache(const SpeechCache&) = delete;
+        SpeechCache& operator=(const SpeechCache&) = delete;
+
+        /// @brief Look up the encoded audio for a request body
+        /// @return true on a hit, with the audio in `audio`
+        bool lookup(const std::string& requestBody, std::string& audio) {
+            std::string name = entryName(requestBody);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (index_.find(name) == index_.end()) {
+                    misses_ += 1;
+                    return false;
+                }
+            }
+
+            if (!readEntry(directory_ / name, requestBody, audio)) {
+                misses_ += 1;
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(name);
+            if (it != index_.end()) {
+                it->second.lastAccess = ++clock_;
+                std::error_code ec;
+                std::filesystem::last_write_time(directory_ / name, std::filesystem::file_time_type::clock::now(), ec);
+            }
+            hits_ += 1;
+            return true;
+        }
+
+        /// @brief Store the encoded audio for a request body, evicting old entries if needed
+        void store(const std::string& requestBody, const std::string& audio) {
+            std::string name = entryName(requestBody);
+            std::filesystem::path target = directory_ / name;
+            if (!writeEntry(target, requestBody, audio)) {
+                return;
+            }
+
+            std::error_code ec;
+            size_t size = static_cast<size_t>(std::filesystem::file_size(target, ec));
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(name);
+            if (it != index_.end()) {
+                bytes_ -= it->second.size;
+            }
+            index_[name] = Entry{ size, ++clock_ };
+            bytes_ += size;
+            stores_ += 1;
+            evict();
+        }
+
+        Stats stats() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return Stats{ hits_.load(), misses_.load(), stores_, evictions_, bytes_, index_.size() };
+        }
+
+        nlohmann::json toJson() const {
+            Stats s = stats();
+            size_t lookups = s.hits + s.misses;
+            return nlohmann::json{
+                {"hits", s.hits},
+                {"misses", s.misses},
+                {"hit_rate", lookups > 0 ? static_cast<double>(s.hits) / lookups : 0.0},
+                {"stores", s.stores},
+                {"evictions", s.evictions},
+                {"bytes", s.bytes},
+                {"entries", s.entries}
+            };
+        }
+
+        /// @brief 64-bit FNV-1a hash
+        static uint64_t hash(const std::string& data) {
+            uint64_t h = 14695981039346656037ull;
+            for (unsigned char c : data) {
+                h ^= c;
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+    private:
+        struct Entry {
+            size_t size; ///< Size of the entry file
+            uint64_t lastAccess; ///< Logical access time, larger is more recent
+        };
+
+        static constexpr char MAGIC[4] = { 'T', 'T', 'S', 'C' };
+        static constexpr const char* EXTENSION = ".tts";
+
+        static std::string entryName(const std::string& requestBody) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash(requestBody)));
+            return std::string{ name } + EXTENSION;
+        }
+
+        /// @brief Rebuild the index from the cache directory, ordering entries by modification time
+        void loadIndex() {
+            std::error_code ec;
+            std::vector<std::pair<std::filesystem::file_time_type, std::string>> files;
+            for (const auto& item : std::filesystem::directory_iterator(directory_, ec)) {
+                std::string name = item.path().filename().string();
+                if (!item.is_regular_file(ec)) {
+                    continue;
+                }
+                if (item.path().extension() != EXTENSION) {
+                    if (name.find(".tmp-") != std::string::npos) {
+                        std::filesystem::remove(item.path(), ec); // Leftover of an interrupted write
+                    }
+                    continue;
+                }
+                files.emplace_back(item.last_write_time(ec), name);
+            }
+            std::sort(files.begin(), files.end());
+
+            for (const auto& file : files) {
+                size_t size = static_cast<size_t>(std::filesystem::file_size(directory_ / file.second, ec));
+                index_[file.second] = Entry{ size, ++clock_ };
+                bytes_ += size;
+            }
+            evict();
+        }
+
+        /// @brief Remove least recently used entries until the cache fits (mutex_ held)
+        void evict() {
+            while (bytes_ > maxBytes_ && !index_.empty()) {
+                auto oldest = index_.begin();
+                for (auto it = index_.begin(); it != index_.end(); ++it) {
+                    if (it->second.lastAccess < oldest->second.lastAccess) {
+                        oldest = it;
+                    }
+                }
+                std::error_code ec;
+                std::filesystem::remove(directory_ / oldest->first, ec);
+                bytes_ -= oldest->second.size;
+                index_.erase(oldest);
+                evictions_ += 1;
+            }
+        }
+
+        static bool readEntry(const std::filesystem::path& path, const std::string& requestBody, std::string& audio) {
+            FILE* file = std::fopen(path.string().c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            char magic[4];
+            uint32_t keySize = 0;
+            bool ok = std::fread(magic, 1, 4, file) == 4 && std::equal(magic, magic + 4, MAGIC)
+                && std::fread(&keySize, sizeof(keySize), 1, file) == 1 && keySize == requestBody.size();
+            if (ok) {
+                std::string key(keySize, '\0');
+                ok = std::fread(&key[0], 1, keySize, file) == keySize && key == requestBody;
+            }
+            if (ok) {
+                audio.clear();
+                char buffer[16384];
+                size_t n = 0;
+                while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                    audio.append(buffer, n);
+                }
+                ok = std::ferror(file) == 0;
+            }
+            std::fclose(file);
+            return ok;
+        }
+
+        bool writeEntry(const std::filesystem::path& target, const std::string& requestBody, const std::string& audio) {
+            std::filesystem::path temporary = target;
+            temporary += ".tmp-" + std::to_string(randomSuffix());
+
+            FILE* file = std::fopen(temporary.string().c_str(), "wb");
+            if (!file) {
+                return false;
+            }
+            uint32_t keySize = static_cast<uint32_t>(requestBody.size());
+            bool ok = std::fwrite(MAGIC, 1, 4, file) == 4
+                && std::fwrite(&keySize, sizeof(keySize), 1, file) == 1
+                && std::fwrite(requestBody.data(), 1, requestBody.size(), file) == requestBody.size()
+                && std::fwrite(audio.data(), 1, audio.size(), file) == audio.size()
+                && std::fflush(file) == 0
+                && syncToDisk(file);
+            ok = std::fclose(file) == 0 && ok;
+
+            std::error_code ec;
+            if (ok) {
+                std::filesystem::rename(temporary, target, ec);
+                ok = !ec;
+            }
+            if (ok) {
+                syncDirectory(target.parent_path()); // The entry is complete either way, this only makes the rename durable
+            }
+            if (!ok) {
+                std::filesystem::remove(temporary, ec);
+            }
+            return ok;
+        }
+
+        static bool syncToDisk(FILE* file) {
+#ifdef _WIN32
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        /// @brief Flush `directory` so a rename into it survives a crash (NTFS journals renames, so a no-op on Windows)
+        static bool syncDirectory(const std::filesystem::path& directory) {
+#ifdef _WIN32
+            (void)directory;
+            return true;
+#else
+            int fd = open(directory.string().c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd < 0) {
+                return false;
+            }
+            bool ok = fsync(fd) == 0;
+            close(fd);
+            return ok;
+#endif
+        }
+
+        unsigned long long randomSuffix() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return random_();
+        }
+
+        std::filesystem::path directory_; ///< Directory holding the entries
+        size_t maxBytes_; ///< Size bound enforced by eviction
+
+        mutable std::mutex mutex_; ///< Protects the index and counters below
+        std::unordered_map<std::string, Entry> index_; ///< Entries by file name
+        uint64_t clock_{ 0 }; ///< Logical clock for LRU ordering
+        size_t bytes_{ 0 };
+        size_t stores_{ 0 };
+        size_t evictions_{ 0 };
+        std::mt19937_64 random_{ std::random_device{}() }; ///< Temporary file name suffixes
+
+        std::atomic<size_t> hits_{ 0 };
+        std::atomic<size_t> misses_{ 0 };
+    };
+
+} // namespace openai
+
+#endif // SPEECH_CACHE_HPP_
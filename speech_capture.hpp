@@ -0,0 +1,300 @@
+#ifndef SPEECH_CAPTURE_HPP_
+#define SPEECH_CAPTURE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <portaudio.h>
+
+#include "audio_source.hpp"
+#include "realtime_transcriber.hpp"
+#include "voice_activity.hpp"
+
+namespace openai {
+
+    /// @brief One utterance forwarded to transcription, in samples of the capture stream
+    struct Utterance {
+        size_t index; ///< 1 for the first utterance of the capture
+        size_t startSample; ///< First forwarded sample, pre-padding included
+        size_t endSample; ///< One past the last forwarded sample, post-padding included
+        long long endNanos; ///< steady_clock time at which the end was detected
+    };
+
+    /**
+    * @brief Capture stage that only uploads speech: runs a VoiceActivityDetector over every captured
+    * frame and forwards speech, with padding, to a RealtimeTranscriber
+    *
+    * The counterpart of playAudio() for input. An utterance starts after `onsetFrames` consecutive
+    * speech frames and is forwarded together with the `prePadding` captured before it, so word onsets
+    * are not clipped; it ends once `postPadding` has passed without speech. At the end the transcriber
+    * is asked to finalize the utterance at once instead of waiting for its own endpointing, and the
+    * utterance-end callback fires, e.g. to start the chat request while the final transcript is on its
+    * way.
+    *
+    * Detection runs in the capture callback and is real-time safe; the callback is invoked from a
+    * separate notifier thread, so it may block. The transcriber must be connected before start().
+    */
+    class SpeechCapture {
+    public:
+        struct Options {
+            std::chrono::milliseconds frameDuration{ 20 }; ///< Length of each VAD frame
+            std::chrono::milliseconds prePadding{ 300 }; ///< Audio before the detected onset that is forwarded too
+            std::chrono::milliseconds postPadding{ 500 }; ///< Silence after the last speech frame that ends the utterance
+            size_t onsetFrames{ 2 }; ///< Consecutive speech frames needed to start an utterance
+            VoiceActivityDetector::Options vad;
+            std::chrono::milliseconds notifyInterval{ 5 }; ///< How often the notifier thread checks for ended utterances
+        };
+
+        using UtteranceCallback = std::function<void(const Utterance&)>;
+
+        explicit SpeechCapture(assemblyai::RealtimeTranscriber& transcriber) : SpeechCapture(transcriber, Options{}) {}
+
+        SpeechCapture(assemblyai::RealtimeTranscriber& transcriber, Options options)
+            : transcriber_{ transcriber }, options_{ options }, vad_{ options.vad } {
+            const int sampleRate = transcriber_.options().sampleRate;
+            frameSamples_ = std::max<size_t>(1, static_cast<size_t>(sampleRate * options_.frameDuration.count() / 1000));
+            options_.onsetFrames = std::max<size_t>(1, options_.onsetFrames);
+            postFrames_ = std::max<size_t>(1, static_cast<size_t>(options_.postPadding / options_.frameDuration));
+            size_t preFrames = static_cast<size_t>(options_.prePadding / options_.frameDuration);
+            frame_.resize(frameSamples_);
+            history_.resize((preFrames + options_.onsetFrames) * frameSamples_);
+        }
+
+        ~SpeechCapture() {
+            stop();
+        }
+
+        SpeechCapture(const SpeechCapture&) = delete;
+        SpeechCapture& operator=(const SpeechCapture&) = delete;
+
+        /// @brief Set the utterance-end callback; must be called before start()
+        void onUtteranceEnd(UtteranceCallback callback) {
+            callback_ = std::move(callback);
+        }
+
+        /// @brief Start capturing from `source` at the transcriber's sample rate
+        bool start(AudioSource& source) {
+            stop();
+            stopping_ = false;
+            notifier_ = std::thread([this] { notify(); });
+            const auto& transcriberOptions = transcriber_.options();
+            source_ = &source;
+            if (!source.start(StreamFormat{ 1, static_cast<double>(transcriberOptions.sampleRate), transcriberOptions.framesPerBuffer },
+                    &SpeechCapture::captureCallback, this)) {
+                source_ = nullptr;
+                stop();
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief Start capturing from the default microphone
+        bool start() {
+            return start(microphone_);
+        }
+
+        /// @brief Stop capturing, end an utterance in progress and deliver the pending callbacks
+        void stop() {
+            if (source_) {
+                source_->stop();
+                source_ = nullptr;
+            }
+            if (inSpeech_) {
+                endUtterance();
+            }
+            stopping_ = true;
+            if (notifier_.joinable()) {
+                notifier_.join();
+            }
+        }
+
+        /// @brief PaStreamCallback for an AudioSource: runs detection on every captured buffer
+        static int captureCallback(const void* inputBuffer, void*, unsigned long frames,
+            const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void* userData) {
+            auto* self = static_cast<SpeechCapture*>(userData);
+            if (inputBuffer) {
+                self->process(static_cast<const float*>(inputBuffer), frames);
+            }
+            return self->stopping_ ? paComplete : paContinue;
+        }
+
+        /// @brief Run detection on captured mono samples and forward the speech (one capture thread; real-time safe)
+        void process(const float* samples, size_t count) {
+            while (count > 0) {
+                size_t n = std::min(frameSamples_ - frameFill_, count);
+                std::copy(samples, samples + n, frame_.begin() + frameFill_);
+                frameFill_ += n;
+                samples += n;
+                count -= n;
+                if (frameFill_ == frameSamples_) {
+                    processFrame();
+                    frameFill_ = 0;
+                }
+            }
+        }
+
+        /// @brief Whether an utterance is being forwarded
+        bool inSpeech() const { return inSpeech_; }
+
+        nlohmann::json toJson() const {
+            size_t captured = capturedSamples_.load();
+            size_t forwarded = forwardedSamples_.load();
+            size_t frames = frames_.load();
+            return nlohmann::json{
+                {"captured_samples", captured},
+                {"forwarded_samples", forwarded},
+                {"forwarded_fraction", captured > 0 ? static_cast<double>(forwarded) / captured : 0.0},
+                {"upload_bytes_saved", (captured - forwarded) * sizeof(int16_t)},
+                {"utterances", utterances_.load()},
+                {"frames", frames},
+                {"speech_frames", speechFrames_.load()},
+                {"noise_db", noiseDb_.load()},
+                {"vad_ns_per_frame", frames > 0 ? static_cast<double>(vadNanos_.load()) / frames : 0.0},
+                {"dropped_events", droppedEvents_.load()}
+            };
+        }
+
+    private:
+        static constexpr size_t EVENT_SLOTS = 16; ///< Ended utterances waiting for the notifier, a power of two
+
+        static long long nanosNow() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// @brief Classify the complete frame in frame_ and forward, buffer or drop it
+        void processFrame() {
+            long long begin = nanosNow();
+            bool speech = vad_.isSpeech(frame_.data(), frameSamples_);
+            vadNanos_.fetch_add(nanosNow() - begin, std::memory_order_relaxed);
+            frames_.fetch_add(1, std::memory_order_relaxed);
+            if (speech) {
+                speechFrames_.fetch_add(1, std::memory_order_relaxed);
+            }
+            noiseDb_.store(vad_.noiseDb(), std::memory_order_relaxed);
+            capturedSamples_.fetch_add(frameSamples_, std::memory_order_relaxed);
+
+            if (!inSpeech_) {
+                onsetRun_ = speech ? onsetRun_ + 1 : 0;
+                remember();
+                if (onsetRun_ >= options_.onsetFrames) {
+                    inSpeech_ = true;
+                    silentRun_ = 0;
+                    utteranceStart_ = capturedSamples_.load(std::memory_order_relaxed) - historyFill_;
+                    forwardHistory();
+                }
+                return;
+            }
+
+            forward(frame_.data(), frameSamples_);
+            silentRun_ = speech ? 0 : silentRun_ + 1;
+            if (silentRun_ >= postFrames_) {
+                endUtterance();
+            }
+        }
+
+        /// @brief Keep the frame in the pre-padding history, overwriting the oldest one
+        void remember() {
+            std::copy(frame_.begin(), frame_.end(), history_.begin() + historyHead_);
+            historyHead_ = (historyHead_ + frameSamples_) % history_.size();
+            historyFill_ = std::min(historyFill_ + frameSamples_, history_.size());
+        }
+
+        /// @brief Forward the history, oldest sample first, and empty it
+        void forwardHistory() {
+            size_t start = (historyHead_ + history_.size() - historyFill_) % history_.size();
+            size_t first = std::min(historyFill_, history_.size() - start);
+            forward(history_.data() + start, first);
+            forward(history_.data(), historyFill_ - first);
+            historyFill_ = 0;
+            historyHead_ = 0;
+        }
+
+        void forward(const float* samples, size_t count) {
+            if (count == 0) {
+                return;
+            }
+            transcriber_.pushAudio(samples, count);
+            forwardedSamples_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /// @brief Finalize the current utterance and queue its callback
+        void endUtterance() {
+            inSpeech_ = false;
+            onsetRun_ = 0;
+            transcriber_.forceEndUtterance();
+            size_t index = utterances_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+            size_t head = eventHead_.load(std::memory_order_relaxed);
+            if (head - eventTail_.load(std::memory_order_acquire) >= EVENT_SLOTS) {
+                droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            events_[head & (EVENT_SLOTS - 1)] = Utterance{ index, utteranceStart_, capturedSamples_.load(std::memory_order_relaxed), nanosNow() };
+            eventHead_.store(head + 1, std::memory_order_release);
+        }
+
+        /// @brief Notifier thread: hand ended utterances to the callback until stopped
+        void notify() {
+            while (true) {
+                bool stopping = stopping_.load(); // Read first so events queued before stop() are delivered
+                size_t tail = eventTail_.load(std::memory_order_relaxed);
+                size_t head = eventHead_.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) {
+                    Utterance utterance = events_[tail & (EVENT_SLOTS - 1)];
+                    eventTail_.store(tail + 1, std::memory_order_release);
+                    if (callback_) {
+                        callback_(utterance);
+                    }
+                }
+                if (stopping) {
+                    return;
+                }
+                std::this_thread::sleep_for(options_.notifyInterval);
+            }
+        }
+
+        assemblyai::RealtimeTranscriber& transcriber_; ///< Receives the speech; connected by the caller
+        Options options_;
+        UtteranceCallback callback_;
+        PortAudioSource microphone_; ///< Used by start() without a source
+        AudioSource* source_{ nullptr }; ///< Source being captured, if any
+        std::thread notifier_; ///< Runs notify()
+
+        // Capture thread only
+        VoiceActivityDetector vad_;
+        size_t frameSamples_{ 0 }; ///< Samples per VAD frame
+        size_t postFrames_{ 0 }; ///< Non-speech frames that end an utterance
+        std::vector<float> frame_; ///< Frame being assembled from capture buffers
+        size_t frameFill_{ 0 };
+        std::vector<float> history_; ///< Recent non-speech frames, the pre-padding of the next utterance
+        size_t historyHead_{ 0 }; ///< Where the next frame is remembered
+        size_t historyFill_{ 0 }; ///< Valid samples in history_
+        size_t onsetRun_{ 0 }; ///< Consecutive speech frames while not in an utterance
+        size_t silentRun_{ 0 }; ///< Consecutive non-speech frames in an utterance
+        size_t utteranceStart_{ 0 };
+        std::atomic<bool> inSpeech_{ false };
+
+        std::array<Utterance, EVENT_SLOTS> events_{}; ///< Ended utterances (capture thread -> notifier thread)
+        std::atomic<size_t> eventHead_{ 0 };
+        std::atomic<size_t> eventTail_{ 0 };
+        std::atomic<bool> stopping_{ true };
+
+        std::atomic<size_t> capturedSamples_{ 0 };
+        std::atomic<size_t> forwardedSamples_{ 0 };
+        std::atomic<size_t> frames_{ 0 };
+        std::atomic<size_t> speechFrames_{ 0 };
+        std::atomic<size_t> utterances_{ 0 };
+        std::atomic<size_t> droppedEvents_{ 0 };
+        std::atomic<long long> vadNanos_{ 0 }; ///< Time spent classifying frames
+        std::atomic<float> noiseDb_{ -120.0f };
+    };
+
+} // namespace openai
+
+#endif // SPEECH_CAPTURE_HPP_
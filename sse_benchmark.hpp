@@ -0,0 +1,217 @@
+#ifndef SSE_BENCHMARK_HPP_
+#define SSE_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "ChatStructures.hpp"
+
+namespace openai {
+
+    namespace detail {
+
+        /// @brief The streamed-completion parsing this project used before SseParser: buffer the bytes,
+        /// cut out every complete event and parse it into a JSON DOM
+        class DomStreamParser {
+        public:
+            void feed(const char* data, size_t size) {
+                if (finished_) {
+                    return;
+                }
+                buffer_.append(data, size);
+                size_t startPos = buffer_.find("data: ");
+                while (startPos != std::string::npos) {
+                    size_t endPos = buffer_.find("\n\n", startPos);
+                    if (endPos == std::string::npos) {
+                        break;
+                    }
+                    std::string json_data = buffer_.substr(startPos + 6, endPos - (startPos + 6));
+                    buffer_.erase(0, endPos + 2);
+
+                    nlohmann::json parsed;
+                    try {
+                        parsed = nlohmann::json::parse(json_data);
+                    }
+                    catch (std::exception&) {
+                        startPos = buffer_.find("data: ");
+                        continue;
+                    }
+                    for (const auto& choice : parsed["choices"]) {
+                        if (choice.contains("delta") && choice["delta"].contains("content")) {
+                            text_ += choice["delta"]["content"].get<std::string>();
+                        }
+                        if (choice.contains("finish_reason") && !choice["finish_reason"].is_null()) {
+                            finished_ = true;
+                        }
+                    }
+                    if (finished_) {
+                        break;
+                    }
+                    startPos = buffer_.find("data: ");
+                }
+            }
+
+            const std::string& text() const { return text_; }
+
+        private:
+            std::string buffer_;
+            std::string text_;
+            bool finished_{ false };
+        };
+
+        /// @brief A chat completion stream as the API sends it: role, one event per token, finish reason, [DONE]
+        inline std::string synthesizeCompletionStream(size_t tokens) {
+            static const char* words[] = {
+                "Roger", ",", " maintain", " heading", " two", "-", "seven", "-", "zero", " and", " climb",
+                " to", " flight", " level", " one", "-", "two", "-", "zero", ".", " Say", " \"", "ready", "\"",
+                " when", " able", ".\n",
+            };
+            auto event = [](nlohmann::json delta, const char* finishReason) {
+                nlohmann::json chunk{
+                    {"id", "chatcmpl-bench"},
+                    {"object", "chat.completion.chunk"},
+                    {"created", 1700000000},
+                    {"model", "gpt-4o-mini"},
+                    {"system_fingerprint", "fp_bench"},
+                    {"choices", nlohmann::json::array({ {
+                        {"index", 0},
+                        {"delta", std::move(delta)},
+                        {"logprobs", nullptr},
+                        {"finish_reason", finishReason ? nlohmann::json(finishReason) : nlohmann::json(nullptr)}
+                    } })}
+                };
+                return "data: " + chunk.dump() + "\n\n";
+            };
+
+            std::string stream = event({ {"role", "assistant"}, {"content", ""} }, nullptr);
+            for (size_t i = 0; i < tokens; ++i) {
+                stream += event({ {"content", words[i % std::size(words)]} }, nullptr);
+            }
+            stream += event(nlohmann::json::object(), "stop");
+            stream += "data: [DONE]\n\n";
+            return stream;
+        }
+
+        /// @brief Cut `stream` at event boundaries, as HTTP/2 usually delivers it
+        inline std::vector<std::string> splitEvents(const std::string& stream) {
+            std::vector<std::string> chunks;
+            size_t start = 0;
+            size_t end;
+            while ((end = stream.find("\n\n", start)) != std::string::npos) {
+                chunks.push_back(stream.substr(start, end + 2 - start));
+                start = end + 2;
+            }
+            if (start < stream.size()) {
+                chunks.push_back(stream.substr(start));
+            }
+            return chunks;
+        }
+
+        /// @brief Cut `stream` at arbitrary points, 1 to 2 * `meanSize` bytes apart (fixed seed)
+        inline std::vector<std::string> splitRandomly(const std::string& stream, size_t meanSize) {
+            std::vector<std::string> chunks;
+            uint32_t state = 12345;
+            size_t start = 0;
+            while (start < stream.size()) {
+                state = state * 1664525u + 1013904223u;
+                size_t size = 1 + (state >> 8) % (2 * meanSize);
+                chunks.push_back(stream.substr(start, size));
+                start += size;
+            }
+            return chunks;
+        }
+
+        /// @brief Median time per chunk in nanoseconds for feeding every chunk to a fresh parser `runs` times
+        template <typename Feed>
+        double timePerChunk(const std::vector<std::string>& chunks, size_t runs, Feed feed) {
+            std::vector<double> perChunk;
+            perChunk.reserve(runs);
+            for (size_t run = 0; run < runs; ++run) {
+                perChunk.push_back(feed(chunks) / chunks.size());
+            }
+            std::nth_element(perChunk.begin(), perChunk.begin() + perChunk.size() / 2, perChunk.end());
+            return perChunk[perChunk.size() / 2];
+        }
+
+        /// @brief Time both parsers on one chunking of the stream
+        inline nlohmann::json compareSseParsers(const std::vector<std::string>& chunks, size_t runs) {
+            std::string domText;
+            std::string sseText;
+            double dom = timePerChunk(chunks, runs, [&](const std::vector<std::string>& input) {
+                DomStreamParser parser;
+                auto begin = std::chrono::steady_clock::now();
+                for (const auto& chunk : input) {
+                    parser.feed(chunk.data(), chunk.size());
+                }
+                auto elapsed = std::chrono::steady_clock::now() - begin;
+                domText = parser.text();
+                return std::chrono::duration<double, std::nano>(elapsed).count();
+            });
+            double sse = timePerChunk(chunks, runs, [&](const std::vector<std::string>& input) {
+                Message message{ MessageType::AIGeneratedResponse };
+                auto begin = std::chrono::steady_clock::now();
+                for (const auto& chunk : input) {
+                    message.setAIResponse(chunk.data(), chunk.size());
+                }
+                auto elapsed = std::chrono::steady_clock::now() - begin;
+                sseText = message.getText();
+                return std::chrono::duration<double, std::nano>(elapsed).count();
+            });
+            return nlohmann::json{
+                {"chunks", chunks.size()},
+                {"dom_ns_per_chunk", dom},
+                {"sse_parser_ns_per_chunk", sse},
+                {"speedup", sse > 0.0 ? dom / sse : 0.0},
+                {"texts_match", domText == sseText},
+                {"text_bytes", sseText.size()}
+            };
+        }
+
+    } // namespace detail
+
+    /**
+    * @brief Compare the incremental SseParser with the old JSON DOM parsing of streamed chat completions
+    *
+    * Feeds a recorded stream (the raw response body of a streaming completion, e.g. saved with
+    * `curl -N ... > stream.txt`) or, without one, a synthesized 2000-token completion through both
+    * parsers: once cut at event boundaries and once cut at random points averaging 64 bytes, which
+    * is where the DOM path's rescanning of the pending buffer shows. Also checks that both extract the
+    * same text.
+    */
+    inline int sse_benchmark_main(const std::string& recordingPath = "") {
+        const size_t runs = 50;
+        std::string stream;
+        if (!recordingPath.empty()) {
+            std::ifstream file(recordingPath, std::ios::binary);
+            if (!file) {
+                std::cerr << "Could not open " << recordingPath << std::endl;
+                return 1;
+            }
+            stream.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        else {
+            stream = detail::synthesizeCompletionStream(2000);
+        }
+
+        nlohmann::json result{
+            {"source", recordingPath.empty() ? "synthesized" : recordingPath},
+            {"stream_bytes", stream.size()},
+            {"runs", runs},
+            {"event_chunks", detail::compareSseParsers(detail::splitEvents(stream), runs)},
+            {"random_chunks", detail::compareSseParsers(detail::splitRandomly(stream, 64), runs)}
+        };
+        std::cout << "SSE benchmark: " << result.dump(2) << std::endl;
+        return 0;
+    }
+
+} // namespace openai
+
+#endif // SSE_BENCHMARK_HPP_
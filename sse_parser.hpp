@@ -0,0 +1,326 @@
+#ifndef SSE_PARSER_HPP_
+#define SSE_PARSER_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace openai {
+
+    /**
+    * @brief Incremental parser for streamed chat completion server-sent events
+    *
+    * Bytes are appended as they arrive from curl; complete lines are consumed from a read cursor and
+    * the consumed prefix is only discarded once it makes up half of the buffer, so every byte is
+    * scanned and moved a bounded number of times. The `data:` payload of each event is scanned in
+    * place for `choices[].delta.content` and `choices[].finish_reason` without building a JSON DOM;
+    * tokens are handed out as string_views into the buffer, or into a reused scratch string when they
+    * contain escapes.
+    */
+    class SseParser {
+    public:
+        /// @brief Receives each content token; the view is only valid during the call
+        using TokenCallback = std::function<void(std::string_view token)>;
+        /// @brief Receives the finish reason once a choice completes ("stop", "length", ...)
+        using FinishCallback = std::function<void(std::string_view reason)>;
+
+        SseParser() = default;
+        SseParser(TokenCallback onToken, FinishCallback onFinish)
+            : onToken_{ std::move(onToken) }, onFinish_{ std::move(onFinish) } {}
+
+        void setTokenCallback(TokenCallback onToken) { onToken_ = std::move(onToken); }
+        void setFinishCallback(FinishCallback onFinish) { onFinish_ = std::move(onFinish); }
+
+        /// @brief Append received bytes and process every complete line
+        void feed(const char* data, size_t size) {
+            buffer_.append(data, size);
+
+            size_t newline;
+            while ((newline = buffer_.find('\n', scan_)) != std::string::npos) {
+                size_t lineEnd = newline;
+                if (lineEnd > cursor_ && buffer_[lineEnd - 1] == '\r') {
+                    --lineEnd;
+                }
+                processLine(std::string_view(buffer_.data() + cursor_, lineEnd - cursor_));
+                cursor_ = newline + 1;
+                scan_ = cursor_;
+            }
+            scan_ = buffer_.size();
+
+            // Drop the consumed prefix once it dominates the buffer (amortized linear)
+            if (cursor_ == buffer_.size()) {
+                buffer_.clear();
+                cursor_ = 0;
+                scan_ = 0;
+            }
+            else if (cursor_ > buffer_.size() / 2) {
+                buffer_.erase(0, cursor_);
+                scan_ -= cursor_;
+                cursor_ = 0;
+            }
+        }
+
+        void feed(std::string_view data) { feed(data.data(), data.size()); }
+
+        /// @brief Whether the `[DONE]` sentinel has been received
+        bool done() const { return done_; }
+
+        void reset() {
+            buffer_.clear();
+            cursor_ = 0;
+            scan_ = 0;
+            done_ = false;
+        }
+
+    private:
+        void processLine(std::string_view line) {
+            // Events are single "data:" lines; blank lines, comments and other fields carry nothing we need
+            if (line.size() < 5 || line.compare(0, 5, "data:") != 0) {
+                return;
+            }
+            line.remove_prefix(5);
+            if (!line.empty() && line.front() == ' ') {
+                line.remove_prefix(1);
+            }
+            if (line == "[DONE]") {
+                done_ = true;
+                return;
+            }
+            p_ = line.data();
+            end_ = line.data() + line.size();
+            skipWhitespace();
+            parseValue({}, {});
+        }
+
+        // Minimal JSON scanner. Each parse function returns false on malformed input, which abandons the event.
+
+        bool parseValue(std::string_view parentKey, std::string_view key) {
+            skipWhitespace();
+            if (p_ >= end_) {
+                return false;
+            }
+            switch (*p_) {
+            case '{': return parseObject(key);
+            case '[': return parseArray(parentKey, key);
+            case '"': {
+                std::string_view value;
+                if (!parseString(value)) {
+                    return false;
+                }
+                if (key == "content" && parentKey == "delta") {
+                    if (onToken_ && !value.empty()) {
+                        onToken_(value);
+                    }
+                }
+                else if (key == "finish_reason") {
+                    if (onFinish_) {
+                        onFinish_(value);
+                    }
+                }
+                return true;
+            }
+            default:
+                // Numbers, true, false, null: skip to the end of the literal
+                while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']') {
+                    ++p_;
+                }
+                return true;
+            }
+        }
+
+        bool parseObject(std::string_view objectKey) {
+            ++p_; // '{'
+            skipWhitespace();
+            if (p_ < end_ && *p_ == '}') {
+                ++p_;
+                return true;
+            }
+            while (p_ < end_) {
+                skipWhitespace();
+                std::string_view key;
+                if (p_ >= end_ || *p_ != '"' || !parseKey(key)) {
+                    return false;
+                }
+                skipWhitespace();
+                if (p_ >= end_ || *p_ != ':') {
+                    return false;
+                }
+                ++p_;
+                if (!parseValue(objectKey, key)) {
+                    return false;
+                }
+                skipWhitespace();
+                if (p_ < end_ && *p_ == ',') {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == '}') {
+                    ++p_;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+
+        bool parseArray(std::string_view parentKey, std::string_view key) {
+            ++p_; // '['
+            skipWhitespace();
+            if (p_ < end_ && *p_ == ']') {
+                ++p_;
+                return true;
+            }
+            while (p_ < end_) {
+                // Elements of an array belong to the array's key (e.g. objects inside "choices")
+                if (!parseValue(parentKey, key)) {
+                    return false;
+                }
+                skipWhitespace();
+                if (p_ < end_ && *p_ == ',') {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == ']') {
+                    ++p_;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+
+        /// @brief Parse a key; keys never need unescaping for the fields we look at
+        bool parseKey(std::string_view& key) {
+            const char* begin = ++p_;
+            while (p_ < end_ && *p_ != '"') {
+                if (*p_ == '\\') {
+                    ++p_;
+                }
+                ++p_;
+            }
+            if (p_ >= end_) {
+                return false;
+            }
+            key = std::string_view(begin, p_ - begin);
+            ++p_;
+            return true;
+        }
+
+        /// @brief Parse a string value, unescaping into scratch_ only when needed
+        bool parseString(std::string_view& value) {
+            const char* begin = ++p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\') {
+                ++p_;
+            }
+            if (p_ >= end_) {
+                return false;
+            }
+            if (*p_ == '"') {
+                value = std::string_view(begin, p_ - begin);
+                ++p_;
+                return true;
+            }
+
+            scratch_.assign(begin, p_ - begin);
+            while (p_ < end_ && *p_ != '"') {
+                if (*p_ != '\\') {
+                    scratch_ += *p_++;
+                    continue;
+                }
+                if (++p_ >= end_) {
+                    return false;
+                }
+                char escape = *p_++;
+                switch (escape) {
+                case 'n': scratch_ += '\n'; break;
+                case 't': scratch_ += '\t'; break;
+                case 'r': scratch_ += '\r'; break;
+                case 'b': scratch_ += '\b'; break;
+                case 'f': scratch_ += '\f'; break;
+                case 'u': {
+                    uint32_t codepoint = 0;
+                    if (!parseHex4(codepoint)) {
+                        return false;
+                    }
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+                        p_ += 2;
+                        uint32_t low = 0;
+                        if (!parseHex4(low)) {
+                            return false;
+                        }
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(codepoint);
+                    break;
+                }
+                default: scratch_ += escape; break; // '"', '\\' and '/'
+                }
+            }
+            if (p_ >= end_) {
+                return false;
+            }
+            ++p_;
+            value = scratch_;
+            return true;
+        }
+
+        bool parseHex4(uint32_t& value) {
+            if (end_ - p_ < 4) {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = *p_++;
+                value <<= 4;
+                if (c >= '0' && c <= '9') value |= c - '0';
+                else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        void appendUtf8(uint32_t codepoint) {
+            if (codepoint < 0x80) {
+                scratch_ += static_cast<char>(codepoint);
+            }
+            else if (codepoint < 0x800) {
+                scratch_ += static_cast<char>(0xC0 | (codepoint >> 6));
+                scratch_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else if (codepoint < 0x10000) {
+                scratch_ += static_cast<char>(0xE0 | (codepoint >> 12));
+                scratch_ += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                scratch_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else {
+                scratch_ += static_cast<char>(0xF0 | (codepoint >> 18));
+                scratch_ += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+                scratch_ += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                scratch_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+        }
+
+        void skipWhitespace() {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+                ++p_;
+            }
+        }
+
+        TokenCallback onToken_;
+        FinishCallback onFinish_;
+
+        std::string buffer_; ///< Received bytes not yet discarded
+        size_t cursor_{ 0 }; ///< Start of the first unconsumed line in buffer_
+        size_t scan_{ 0 }; ///< Position from which to look for the next newline
+        bool done_{ false }; ///< "[DONE]" received
+
+        const char* p_{ nullptr }; ///< Scanner position within the current event
+        const char* end_{ nullptr }; ///< End of the current event
+        std::string scratch_; ///< Reused buffer for unescaped strings
+    };
+
+} // namespace openai
+
+#endif // SSE_PARSER_HPP_
@@ -0,0 +1,228 @@
+#ifndef TOKEN_MANAGER_HPP_
+#define TOKEN_MANAGER_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#include "assemblyai.h"
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+
+namespace assemblyai {
+
+    /**
+    * @brief Keeps a temporary realtime token ready so opening a session never waits on the token API
+    *
+    * A worker thread fetches a token as soon as the manager is created and replaces it once
+    * `refreshAfter` of its lifetime has passed, well before it expires. Callers read the cached token
+    * under a mutex; when there is none (the first fetch has not finished, or every attempt failed)
+    * they wait for the worker, so any number of concurrent callers share a single in-flight request.
+    * Failed fetches are retried with exponential backoff.
+    *
+    * Expiry is measured from when the request was sent, so the cached deadline is never later than
+    * the server's.
+    */
+    class TokenManager {
+    public:
+        struct Options {
+            std::chrono::seconds lifetime{ 600 }; ///< expires_in asked for each token; the API accepts 60 to 360000 s
+            double refreshAfter{ 0.75 }; ///< Fraction of the lifetime after which a replacement is fetched
+            std::chrono::seconds minRemaining{ 30 }; ///< Tokens closer to expiry than this are not handed out
+            std::chrono::milliseconds requestTimeout{ 10000 };
+            std::chrono::milliseconds retryDelay{ 500 }; ///< First retry after a failed fetch, doubled per failure
+            std::chrono::milliseconds maxRetryDelay{ 30000 };
+        };
+
+        explicit TokenManager(std::string apiKey) : TokenManager(std::move(apiKey), Options{}) {}
+
+        TokenManager(std::string apiKey, Options options)
+            : apiKey_{ std::move(apiKey) }, options_{ options } {
+            options_.lifetime = std::clamp(options_.lifetime, std::chrono::seconds{ 60 }, std::chrono::seconds{ 360000 });
+            options_.refreshAfter = std::clamp(options_.refreshAfter, 0.1, 1.0);
+            nextFetch_ = Clock::now();
+            worker_ = std::thread([this] { run(); });
+        }
+
+        ~TokenManager() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+                cv_.notify_all();
+            }
+            if (worker_.joinable()) {
+                worker_.join();
+            }
+        }
+
+        TokenManager(const TokenManager&) = delete;
+        TokenManager& operator=(const TokenManager&) = delete;
+
+        /// @brief The cached token, without ever waiting for a fetch
+        /// @return false if no usable token is cached yet
+        bool tryGet(std::string& token) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!usable(Clock::now())) {
+                return false;
+            }
+            cacheHits_ += 1;
+            token = token_;
+            return true;
+        }
+
+        /// @brief The cached token, or the result of the fetch in flight if there is none
+        ///
+        /// Joins the worker's current request instead of starting another one; if the worker is idle
+        /// (backing off after a failure) it is woken to fetch now.
+        /// @return The token, or an empty string if none could be fetched within `timeout`
+        std::string get(std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (usable(Clock::now())) {
+                cacheHits_ += 1;
+                return token_;
+            }
+
+            waits_ += 1;
+            if (fetching_) {
+                coalescedWaits_ += 1;
+            }
+            else {
+                fetchNow_ = true;
+                cv_.notify_all();
+            }
+            auto deadline = Clock::now() + timeout;
+            size_t generation = generation_;
+            // A fetch that completes without a usable token (a failure) ends the wait as well
+            cv_.wait_until(lock, deadline, [&] {
+                return stopping_ || usable(Clock::now()) || (generation_ != generation && !fetching_ && !fetchNow_);
+            });
+            return usable(Clock::now()) ? token_ : std::string{};
+        }
+
+        /// @brief Drop `token` if it is still the cached one, e.g. after the server rejected it, and fetch a new one
+        void invalidate(const std::string& token) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (token.empty() || token != token_) {
+                return;
+            }
+            token_.clear();
+            invalidations_ += 1;
+            fetchNow_ = true;
+            cv_.notify_all();
+        }
+
+        /// @brief Seconds until the cached token expires, 0 if there is none
+        double secondsRemaining() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (token_.empty()) {
+                return 0.0;
+            }
+            return std::max(0.0, std::chrono::duration<double>(expiresAt_ - Clock::now()).count());
+        }
+
+        nlohmann::json toJson() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return nlohmann::json{
+                {"lifetime_s", options_.lifetime.count()},
+                {"fetches", fetches_},
+                {"fetch_failures", failures_},
+                {"cache_hits", cacheHits_},
+                {"waits", waits_},
+                {"coalesced_waits", coalescedWaits_},
+                {"invalidations", invalidations_},
+                {"seconds_remaining", token_.empty() ? 0.0 : std::max(0.0, std::chrono::duration<double>(expiresAt_ - Clock::now()).count())},
+                {"fetch_latency", fetchLatency_.toJson()}
+            };
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /// @brief Whether the cached token may be handed out at `now` (mutex held)
+        bool usable(Clock::time_point now) const {
+            return !token_.empty() && expiresAt_ - now > options_.minRemaining;
+        }
+
+        /// @brief When to replace a token requested at `sent`: after refreshAfter of its lifetime, but early
+        /// enough that the replacement arrives before the old token stops being handed out
+        Clock::time_point refreshTime(Clock::time_point sent) const {
+            auto lifetime = std::chrono::duration_cast<Clock::duration>(options_.lifetime);
+            auto refresh = std::chrono::duration_cast<Clock::duration>(lifetime * options_.refreshAfter);
+            refresh = std::min(refresh, lifetime - std::chrono::duration_cast<Clock::duration>(options_.minRemaining + options_.requestTimeout));
+            return sent + std::max(refresh, lifetime / 10);
+        }
+
+        /// @brief Worker loop: fetch when the cached token is due for replacement or a caller needs one now
+        void run() {
+            std::chrono::milliseconds retryDelay = options_.retryDelay;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait_until(lock, nextFetch_, [this] { return stopping_ || fetchNow_; });
+                if (stopping_) {
+                    return;
+                }
+                if (!fetchNow_ && Clock::now() < nextFetch_) {
+                    continue;
+                }
+                fetchNow_ = false;
+                fetching_ = true;
+                lock.unlock();
+
+                auto sent = Clock::now();
+                std::string token = fetchToken(apiKey_, static_cast<int>(options_.lifetime.count()), static_cast<long>(options_.requestTimeout.count()));
+                auto received = Clock::now();
+                fetchLatency_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(received - sent).count()));
+
+                lock.lock();
+                fetching_ = false;
+                generation_ += 1;
+                if (!token.empty()) {
+                    fetches_ += 1;
+                    token_ = std::move(token);
+                    expiresAt_ = sent + options_.lifetime;
+                    nextFetch_ = refreshTime(sent);
+                    retryDelay = options_.retryDelay;
+                    OPENAI_LOG_DEBUG("realtime_token_refreshed", "Valid for %lld s", static_cast<long long>(options_.lifetime.count()));
+                }
+                else {
+                    failures_ += 1;
+                    nextFetch_ = received + retryDelay;
+                    OPENAI_LOG_WARN("realtime_token_retry", "Retrying in %lld ms", static_cast<long long>(retryDelay.count()));
+                    retryDelay = std::min(retryDelay * 2, options_.maxRetryDelay);
+                }
+                cv_.notify_all();
+            }
+        }
+
+        std::string apiKey_;
+        Options options_;
+
+        mutable std::mutex mutex_; ///< Protects every field below except fetchLatency_
+        std::condition_variable cv_; ///< Wakes the worker (fetchNow_, stopping_) and waiting callers (generation_)
+        std::string token_; ///< Cached token, empty if there is none
+        Clock::time_point expiresAt_; ///< When token_ expires
+        Clock::time_point nextFetch_; ///< When the worker fetches next on its own
+        size_t generation_{ 0 }; ///< Completed fetch attempts, successful or not
+        bool fetching_{ false }; ///< A request is in flight
+        bool fetchNow_{ false }; ///< A caller needs a token; fetch without waiting for nextFetch_
+        bool stopping_{ false };
+
+        size_t fetches_{ 0 };
+        size_t failures_{ 0 };
+        size_t cacheHits_{ 0 }; ///< Calls answered from the cache
+        size_t waits_{ 0 }; ///< Calls that had to wait for a fetch
+        size_t coalescedWaits_{ 0 }; ///< Waits that joined a request already in flight
+        size_t invalidations_{ 0 };
+        openai::LatencyHistogram fetchLatency_; ///< Duration of every fetch attempt
+
+        std::thread worker_; ///< Runs run()
+    };
+
+} // namespace assemblyai
+
+#endif // TOKEN_MANAGER_HPP_
@@ -0,0 +1,142 @@
+#ifndef VOICE_ACTIVITY_HPP_
+#define VOICE_ACTIVITY_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <nlohmann/json.hpp>
+
+namespace openai {
+
+    /// @brief Per-frame measurements the voice activity decision is based on
+    struct FrameFeatures {
+        float energyDb; ///< Mean power of the frame after removing its DC offset, dB relative to full scale
+        float zeroCrossingRate; ///< Sign changes around the mean per sample, 0 to 1
+    };
+
+    /**
+    * @brief Energy and zero-crossing rate of one frame in two passes
+    *
+    * Both loops are written so the compiler can vectorize them without -ffast-math: the sums are kept
+    * in LANES independent accumulators, and the sign comparison is a branch-free integer reduction.
+    */
+    inline FrameFeatures measureFrame(const float* samples, size_t count) {
+        constexpr size_t LANES = 8;
+        if (count == 0) {
+            return FrameFeatures{ -120.0f, 0.0f };
+        }
+
+        float sums[LANES] = {};
+        float squares[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES) {
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                sums[lane] += samples[i + lane];
+                squares[lane] += samples[i + lane] * samples[i + lane];
+            }
+        }
+        for (; i < count; ++i) {
+            sums[0] += samples[i];
+            squares[0] += samples[i] * samples[i];
+        }
+        float sum = 0.0f;
+        float sumOfSquares = 0.0f;
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            sum += sums[lane];
+            sumOfSquares += squares[lane];
+        }
+        float mean = sum / count;
+        float power = std::max(sumOfSquares / count - mean * mean, 0.0f);
+
+        unsigned crossings = 0;
+        for (size_t j = 1; j < count; ++j) {
+            crossings += static_cast<unsigned>((samples[j - 1] < mean) != (samples[j] < mean));
+        }
+
+        return FrameFeatures{
+            10.0f * std::log10(power + 1e-12f),
+            count > 1 ? static_cast<float>(crossings) / (count - 1) : 0.0f
+        };
+    }
+
+    /**
+    * @brief Frame-level speech detector on energy above an adaptive noise floor and zero-crossing rate
+    *
+    * A frame is speech when its energy is `marginDb` above the tracked noise floor (and above
+    * `minEnergyDb`) and its zero-crossing rate is at most `maxZeroCrossingRate`, which rejects hiss
+    * and other broadband noise; frames another `strongMarginDb` louder count regardless of their
+    * zero-crossing rate, so loud fricatives are kept. The noise floor follows the energy of
+    * non-speech frames, quickly downwards and slowly upwards, and creeps up very slowly during speech
+    * so a lasting rise in background noise is eventually absorbed. It starts from the first frame's
+    * energy, capped at `minEnergyDb` so speech already under way when capture starts is detected.
+    *
+    * Classification only; onset smoothing and padding are up to the caller (see SpeechCapture).
+    * Allocation-free and cheap enough for a real-time capture callback.
+    */
+    class VoiceActivityDetector {
+    public:
+        struct Options {
+            float marginDb{ 10.0f }; ///< Energy above the noise floor needed for speech
+            float strongMarginDb{ 10.0f }; ///< Further energy above which the zero-crossing rate is ignored
+            float minEnergyDb{ -55.0f }; ///< Frames quieter than this are never speech
+            float maxZeroCrossingRate{ 0.35f }; ///< White noise is around 0.5, voiced speech well below 0.2
+            float noiseRise{ 0.02f }; ///< Per-frame adaptation of the noise floor towards louder non-speech frames
+            float noiseFall{ 0.5f }; ///< Per-frame adaptation towards quieter frames
+            float noiseRiseInSpeech{ 0.001f }; ///< Per-frame adaptation while speech is detected
+        };
+
+        VoiceActivityDetector() : VoiceActivityDetector(Options{}) {}
+        explicit VoiceActivityDetector(Options options) : options_{ options } {}
+
+        /// @brief Classify one frame and update the noise floor
+        bool isSpeech(const float* samples, size_t count) {
+            last_ = measureFrame(samples, count);
+            if (frames_ == 0) {
+                noiseDb_ = std::min(last_.energyDb, options_.minEnergyDb); // Capture may start in the middle of speech
+            }
+            frames_ += 1;
+
+            float threshold = std::max(options_.minEnergyDb, noiseDb_ + options_.marginDb);
+            bool speech = last_.energyDb >= threshold
+                && (last_.zeroCrossingRate <= options_.maxZeroCrossingRate || last_.energyDb >= threshold + options_.strongMarginDb);
+
+            float rate = speech ? options_.noiseRiseInSpeech : last_.energyDb < noiseDb_ ? options_.noiseFall : options_.noiseRise;
+            noiseDb_ += rate * (last_.energyDb - noiseDb_);
+            if (speech) {
+                speechFrames_ += 1;
+            }
+            return speech;
+        }
+
+        /// @brief Features of the last classified frame
+        const FrameFeatures& lastFeatures() const { return last_; }
+
+        /// @brief Current noise floor estimate in dBFS
+        float noiseDb() const { return noiseDb_; }
+
+        void reset() {
+            frames_ = 0;
+            speechFrames_ = 0;
+            noiseDb_ = -120.0f;
+        }
+
+        nlohmann::json toJson() const {
+            return nlohmann::json{
+                {"frames", frames_},
+                {"speech_frames", speechFrames_},
+                {"noise_db", noiseDb_}
+            };
+        }
+
+    private:
+        Options options_;
+        FrameFeatures last_{ -120.0f, 0.0f };
+        float noiseDb_{ -120.0f }; ///< Noise floor, seeded from the first frame
+        size_t frames_{ 0 };
+        size_t speechFrames_{ 0 };
+    };
+
+} // namespace openai
+
+#endif // VOICE_ACTIVITY_HPP_